@@ -0,0 +1,235 @@
+/* Name: analog.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "analog.h"
+#include "midiin.h"
+#include "midiout.h"
+#include "usbsafe.h"
+
+#if ANALOG_COUNT
+
+#if ANALOG_MUX
+#define INPUTS		((ANALOG_COUNT + 7) / 8)
+#else
+#define INPUTS		ANALOG_COUNT
+#endif
+#if ANALOG_ADC_FIRST + INPUTS > 6
+#error "not enough ADC inputs for ANALOG_COUNT"
+#endif
+#if KEYS_DRIVER == KEYS_MATRIX && ANALOG_ADC_FIRST < KEYS_ROWS
+#error "ADC inputs overlap the key matrix rows"
+#endif
+#if ANALOG_OVERSAMPLE > 64 || (ANALOG_OVERSAMPLE & (ANALOG_OVERSAMPLE - 1))
+#error "ANALOG_OVERSAMPLE must be a power of two <= 64"
+#endif
+#if ANALOG_RESOLUTION == ANALOG_CC14 && ANALOG_CC_BASE + ANALOG_COUNT > 32
+#error "14 bit controllers must be below CC 32"
+#endif
+
+#define ADMUX_BASE	(1 << REFS0)	/* AVcc reference */
+#define MUX_SHIFT	5		/* select lines on PD5..PD7 */
+#define MUX_MASK	(7 << MUX_SHIFT)
+
+/* sum of ANALOG_OVERSAMPLE 10 bit samples to the output range, a shift */
+#if ANALOG_RESOLUTION == ANALOG_CC7
+typedef uchar value_t;
+#define VALUE_NONE	0xff
+#define TO_VALUE(sum)	((value_t) ((sum) / (8 * ANALOG_OVERSAMPLE)))
+#else
+typedef unsigned value_t;
+#define VALUE_NONE	0xffff
+#if ANALOG_OVERSAMPLE <= 16
+#define TO_VALUE(sum)	((sum) * (16 / ANALOG_OVERSAMPLE))
+#else
+#define TO_VALUE(sum)	((sum) / (ANALOG_OVERSAMPLE / 16))
+#endif
+#endif
+
+static unsigned level[ANALOG_COUNT];	/* accepted sum, interrupt only */
+static value_t value[ANALOG_COUNT];	/* output value of level */
+static volatile uchar pending[ANALOG_COUNT];	/* value not yet queued */
+static value_t sent[ANALOG_COUNT];	/* last value queued, main only */
+#if ANALOG_RESOLUTION == ANALOG_NRPN
+static uchar nrpnSelected;	/* pot whose NRPN the receiver has selected */
+#endif
+
+static uchar pot;		/* pot being converted */
+static uchar count;		/* conversions done on pot, 0 = settling */
+static unsigned sum;
+
+/* Routes pot p to the ADC. */
+static void select(uchar p)
+{
+#if ANALOG_MUX
+	PORTD = (PORTD & ~MUX_MASK) | ((p & 7) << MUX_SHIFT);
+	ADMUX = ADMUX_BASE | (ANALOG_ADC_FIRST + (p >> 3));
+#else
+	ADMUX = ADMUX_BASE | (ANALOG_ADC_FIRST + p);
+#endif
+}
+
+void analogInit(void)
+{
+	uchar i;
+
+	for (i = 0; i < ANALOG_COUNT; i++) {
+		value[i] = VALUE_NONE;	/* the first sum is taken as it is */
+		sent[i] = VALUE_NONE;	/* send every pot's position once */
+	}
+#if ANALOG_RESOLUTION == ANALOG_NRPN
+	nrpnSelected = 0xff;
+#endif
+#if ANALOG_MUX
+	DDRD |= MUX_MASK;
+#endif
+	DIDR0 = ((1 << INPUTS) - 1) << ANALOG_ADC_FIRST;
+	PORTC &= ~DIDR0;	/* no pull-ups on the analog inputs */
+	pot = 0;
+	count = 0;
+	sum = 0;
+	select(0);
+	ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADIE) |
+	    (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);	/* F_CPU / 128 */
+}
+
+#if ANALOG_DIN
+static void dinCC(uchar cc, uchar v)
+{
+	uchar packet[4];
+
+	packet[0] = 0x0b;
+	packet[1] = 0xb0 | ANALOG_CHANNEL;
+	packet[2] = cc;
+	packet[3] = v;
+	midiOutPacket(packet);	/* running status drops the repeated 0xbn */
+}
+#else
+#define dinCC(cc, v)
+#endif
+
+static uchar putCC(uchar cc, uchar v)
+{
+	if (!midiInPut(0x0b, 0xb0 | ANALOG_CHANNEL, cc, v))
+		return 0;
+	dinCC(cc, v);
+	return 1;
+}
+
+#if ANALOG_RESOLUTION != ANALOG_CC7
+/* Both halves go out in the same interrupt-in packet. */
+static uchar putPair(uchar cc1, uchar v1, uchar cc2, uchar v2)
+{
+	if (!midiInPutPair(0x0b, 0xb0 | ANALOG_CHANNEL, cc1, v1, cc2, v2))
+		return 0;
+	dinCC(cc1, v1);
+	dinCC(cc2, v2);
+	return 1;
+}
+#endif
+
+/* Queues the events that take the receiver from sent[i] to v. The MSB is
+ * only repeated when it changes, so slow moves cost one event like 7 bit
+ * controllers do.
+ */
+static uchar send(uchar i, value_t v)
+{
+#if ANALOG_RESOLUTION == ANALOG_CC7
+	return putCC(ANALOG_CC_BASE + i, v);
+#elif ANALOG_RESOLUTION == ANALOG_CC14
+	if ((v >> 7) == (sent[i] >> 7))
+		return putCC(ANALOG_CC_BASE + 32 + i, v & 0x7f);
+	return putPair(ANALOG_CC_BASE + i, v >> 7,
+		       ANALOG_CC_BASE + 32 + i, v & 0x7f);
+#else
+	if (nrpnSelected != i) {
+		if (!putPair(99, ANALOG_NRPN_MSB, 98, ANALOG_CC_BASE + i))
+			return 0;
+		nrpnSelected = i;
+		sent[i] = VALUE_NONE;	/* data MSB as well after selecting */
+	}
+	if ((v >> 7) == (sent[i] >> 7))
+		return putCC(38, v & 0x7f);
+	return putPair(6, v >> 7, 38, v & 0x7f);
+#endif
+}
+
+uchar analogPoll(void)
+{
+	uchar i, sreg;
+	value_t v;
+
+	for (i = 0; i < ANALOG_COUNT; i++) {
+		if (!pending[i])
+			continue;
+		if (midiInEventDepth() >= ANALOG_QUEUE_LIMIT)
+			return 1;
+		pending[i] = 0;
+		sreg = SREG;
+		cli();		/* value may be two bytes */
+		v = value[i];
+		SREG = sreg;
+		if (v == sent[i])
+			continue;
+		if (!send(i, v)) {
+			pending[i] = 1;
+			return 1;
+		}
+		sent[i] = v;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* ADC conversion complete                                                   */
+/*                                                                           */
+/* The flag clears on entry. The next conversion is started on the way out,  */
+/* so the handler cannot nest with itself however long USB holds it up.      */
+/*---------------------------------------------------------------------------*/
+
+USB_SAFE_ISR(ADC_vect)
+{
+	unsigned sample = ADC, diff;
+	uchar p = pot, n = count;
+
+	if (n < ANALOG_OVERSAMPLE) {
+		count = n + 1;
+		if (n)		/* 0 is the settling conversion after select() */
+			sum += sample;
+	} else {
+		sum += sample;
+		diff = (sum > level[p]) ? sum - level[p] : level[p] - sum;
+		if (diff > ANALOG_HYSTERESIS || value[p] == VALUE_NONE) {
+			level[p] = sum;
+			sample = TO_VALUE(sum);
+			if (sample != value[p]) {
+				value[p] = sample;
+				pending[p] = 1;
+			}
+		}
+		sum = 0;
+		count = 0;
+		if (++p == ANALOG_COUNT)
+			p = 0;
+		pot = p;
+		select(p);
+	}
+	ADCSRA |= (1 << ADSC);
+}
+
+#else				/* ANALOG_COUNT */
+
+void analogInit(void)
+{
+}
+
+uchar analogPoll(void)
+{
+	return 0;
+}
+
+#endif				/* ANALOG_COUNT */
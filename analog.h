@@ -0,0 +1,59 @@
+/* Name: analog.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __analog_h_included__
+#define __analog_h_included__
+
+/*
+General Description:
+Potentiometers and sliders as control changes. The ADC complete interrupt
+converts one pot after the other: each pot gets one settling conversion
+after its input is selected, then ANALOG_OVERSAMPLE conversions which are
+summed. A new sum only moves the pot's level if it differs from it by more
+than ANALOG_HYSTERESIS, so a pot resting between two values stays quiet.
+The hysteresis is in sum units and goes with the output step: by default
+3 ADC steps for 7 bit controllers, whose step is 8 ADC steps, and half an
+ADC step in the 14 bit modes, so all 10 bits of the ADC can move.
+The first sum after analogInit() is always taken, so every pot is sent
+once, a pot at zero included.
+When the 7 bit value of the level changes the interrupt marks the pot
+pending; it keeps at most one pending value per pot and a newer value
+replaces an older one.
+
+analogPoll() turns pending pots into events on ANALOG_CHANNEL, but only
+while the event queue holds fewer than ANALOG_QUEUE_LIMIT packets. A fast
+knob twist therefore skips intermediate values instead of queueing more
+than the interrupt-in pipe carries. ANALOG_RESOLUTION selects the events:
+ANALOG_CC7	CC ANALOG_CC_BASE + n.
+ANALOG_CC14	14 bit: MSB on CC ANALOG_CC_BASE + n, LSB on CC + 32.
+ANALOG_NRPN	14 bit NRPN ANALOG_NRPN_MSB / ANALOG_CC_BASE + n, selected
+		(CC 99, 98) only when another pot was sent last.
+In the 14 bit modes the MSB is only sent when it changes, and an MSB/LSB
+pair always shares one interrupt-in packet (midiInPutPair()), so the host
+never sees half a value. With ANALOG_DIN the events also go to DIN out,
+where running status drops the repeated status byte.
+
+Pots are on ADC inputs ANALOG_ADC_FIRST.. (PC0..). With ANALOG_MUX each of
+those inputs is the common pin of a 4051 whose select lines S0..S2 are on
+PD5..PD7, for up to 8 pots per input. The interrupt takes about 60 cycles,
+about 150 when a pot's sum is complete; at F_CPU / 128 that is a
+conversion every 104 us, at most 2% of the CPU.
+*/
+
+#include "midicomconfig.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+void analogInit(void);
+/* Configures the ADC (and mux select pins) and starts converting.
+ */
+uchar analogPoll(void);
+/* Queues CC events for pending pots. Returns non-zero if pots are still
+ * pending because the queue limit was reached.
+ */
+
+#endif				/* __analog_h_included__ */
@@ -0,0 +1,273 @@
+/* Name: config.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+#include "config.h"
+#include "keymap.h"
+
+/* A slot is the sequence number, CONFIG_VERSION, config_t and a checksum
+ * over all of them. Saves write bytes 1.. first, then 0, then the sum.
+ */
+#define SLOT_SIZE	(sizeof(config_t) + 3)
+#define SLOT_SUM	(SLOT_SIZE - 1)
+#define SLOT_FIT	((E2END + 1) / SLOT_SIZE)
+#define CONFIG_SLOTS	(SLOT_FIT < 64 ? SLOT_FIT : 64)
+#define SUM_SEED	0x5a	/* a blank or zeroed slot does not add up */
+#define SYSEX_ID	0x6d	/* after the non-commercial ID 0x7d */
+#define SYSEX_SKIP	0xff	/* sysexPos of a command other than write */
+#define CONFIG_BUSY_MS	250	/* configPoll() calls, see config.h */
+#define SHADOW_BARRIER()	asm volatile ("" ::: "memory")
+
+typedef char configSlotCheck[SLOT_SIZE <= 255 && SLOT_FIT >= 2 ? 1 : -1];
+
+config_t config;
+volatile uchar configBusy;	/* configPoll() calls left of a write */
+
+static EEMEM uchar store[CONFIG_SLOTS][SLOT_SIZE];
+static uchar slot;		/* slot of the copy in charge */
+static uchar seq;		/* its sequence number */
+static uchar dirty;		/* shadow changed, save pending */
+static uchar savePos;		/* bytes of the save written, SLOT_SIZE idle */
+static uchar saveSum;
+static unsigned xferPos;	/* RQ_READ_CONFIG, RQ_WRITE_CONFIG */
+static unsigned xferLeft;	/* bytes inside config_t */
+static unsigned xferHost;	/* bytes the host sends in all */
+static uchar sysexPos;		/* bytes of a configuration SysEx seen */
+static uchar sysexHigh;
+static uchar sysexDirty;	/* the SysEx under way has written bytes */
+static unsigned sysexAddr;
+
+static uchar slotValid(uchar s)
+{
+	uchar i, sum = SUM_SEED;
+
+	if (eeprom_read_byte(&store[s][1]) != CONFIG_VERSION)
+		return 0;
+	for (i = 0; i < SLOT_SUM; i++)
+		sum += eeprom_read_byte(&store[s][i]);
+	return sum == eeprom_read_byte(&store[s][SLOT_SUM]);
+}
+
+void configDefaults(void)
+{
+	uchar i;
+
+	memset(&config, 0, sizeof(config));
+	for (i = 1; i < KEYMAP_ZONES; i++)
+		config.keymap.zone[i].low = KEYMAP_ZONE_OFF;
+	config.keymap.zone[0].high = 127;
+	config.keymap.zone[0].channel = KEYMAP_CHANNEL;
+	memset(config.keymap.note, KEYMAP_DEFAULT, KEYMAP_KEYS);
+#if FILTER_RULES
+	filterDefaults(&config.filter[FILTER_IN]);
+	filterDefaults(&config.filter[FILTER_OUT]);
+#endif
+}
+
+void configInit(void)
+{
+	uchar s, n, found = 0;
+
+	for (s = 0; s < CONFIG_SLOTS; s++) {
+		if (!slotValid(s))
+			continue;
+		n = eeprom_read_byte(&store[s][0]);
+		if (!found || (signed char) (n - seq) > 0) {
+			found = 1;
+			seq = n;
+			slot = s;
+		}
+	}
+	if (found) {
+		eeprom_read_block(&config, &store[slot][2], sizeof(config));
+	} else {
+		configDefaults();
+		slot = CONFIG_SLOTS - 1;	/* first save to slot 0 */
+		seq = 0;
+	}
+	savePos = SLOT_SIZE;
+}
+
+void configChanged(void)
+{
+	keymapLoad();
+	dirty = 1;
+}
+
+/* Marks the shadow busy before a write puts a byte in, and again with
+ * every byte, so a write in progress never times out. A new write first
+ * releases the keys held under the old map; returns 0 if it has to wait
+ * because their note offs do not fit the event queue.
+ */
+static uchar writeStart(void)
+{
+	if (!configBusy && !keymapRelease())
+		return 0;
+	configBusy = CONFIG_BUSY_MS;
+	SHADOW_BARRIER();	/* the flag goes before the bytes */
+	return 1;
+}
+
+/* Applies the shadow once no write is coming in any more. */
+static void writeDone(void)
+{
+	if (xferHost || sysexDirty)	/* a SysEx and a request overlap */
+		return;
+	SHADOW_BARRIER();
+	configBusy = 0;
+	configChanged();
+}
+
+uchar configPoll(void)
+{
+	uchar i, v, next = (slot + 1 == CONFIG_SLOTS) ? 0 : slot + 1;
+
+	if (configBusy && !--configBusy) {	/* the host gave up */
+		xferHost = 0;
+		sysexDirty = 0;
+		writeDone();
+	}
+	if (!eeprom_is_ready())
+		return 0;
+	if (savePos == SLOT_SIZE) {
+		if (!dirty)
+			return 0;
+		dirty = 0;
+		savePos = 0;
+		saveSum = SUM_SEED;
+	}
+	if (savePos < SLOT_SUM - 1) {
+		i = savePos + 1;
+		v = (i == 1) ? CONFIG_VERSION : ((uchar *) &config)[i - 2];
+	} else if (savePos == SLOT_SUM - 1) {
+		i = 0;
+		v = seq + 1;
+	} else {
+		i = SLOT_SUM;
+		v = saveSum;
+	}
+	saveSum += v;
+	eeprom_update_byte(&store[next][i], v);
+	if (++savePos == SLOT_SIZE) {
+		slot = next;
+		seq++;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Host access                                                               */
+/*---------------------------------------------------------------------------*/
+
+void configReadBegin(unsigned offset, unsigned len)
+{
+	if (offset > sizeof(config))
+		offset = sizeof(config);
+	if (len > sizeof(config) - offset)
+		len = sizeof(config) - offset;
+	xferPos = offset;
+	xferLeft = len;
+}
+
+uchar configRead(uchar * data, uchar len)
+{
+	if (len > xferLeft)
+		len = xferLeft;
+	memcpy(data, (uchar *) &config + xferPos, len);
+	xferPos += len;
+	xferLeft -= len;
+	return len;
+}
+
+void configWriteBegin(unsigned offset, unsigned len)
+{
+	configReadBegin(offset, len);
+	xferHost = len;
+}
+
+uchar configWrite(uchar * data, uchar len)
+{
+	uchar n = (len < xferLeft) ? len : xferLeft;
+
+	if (!writeStart()) {
+		xferHost = 0;
+		return 0xff;	/* stall, the host tries again */
+	}
+	memcpy((uchar *) &config + xferPos, data, n);
+	xferPos += n;
+	xferLeft -= n;
+	xferHost = (len < xferHost) ? xferHost - len : 0;
+	if (xferHost)
+		return 0;
+	writeDone();
+	return 1;
+}
+
+/* Byte 3 on of the SysEx: command, offset, then nibble pairs. */
+static void sysexByte(uchar c)
+{
+	if (sysexPos == SYSEX_SKIP)
+		return;
+	if (sysexPos == 3) {
+		if (c != 0x01) {
+			sysexPos = SYSEX_SKIP;	/* taken, but not applied */
+			return;
+		}
+	} else if (sysexPos == 4) {
+		sysexAddr = c << 7;
+	} else if (sysexPos == 5) {
+		sysexAddr |= c;
+	} else if (sysexPos == 6) {
+		sysexHigh = c << 4;
+	} else {
+		if (sysexAddr < sizeof(config)) {
+			if (!writeStart()) {
+				sysexPos = SYSEX_SKIP;	/* see configSysex() */
+				return;
+			}
+			sysexDirty = 1;
+			((uchar *) &config)[sysexAddr] =
+			    sysexHigh | (c & 0x0f);
+		}
+		sysexAddr++;
+		sysexPos = 5;
+	}
+	sysexPos++;
+}
+
+uchar configSysex(uchar * packet)
+{
+	uchar cin = packet[0] & 0x0f, n, i;
+
+	if (cin < 0x04 || cin > 0x07)
+		return 0;
+	if (packet[1] == 0xf0) {
+		if (sysexDirty) {	/* the last one was cut off */
+			sysexDirty = 0;
+			writeDone();
+		}
+		sysexPos = (cin == 0x04 && packet[2] == 0x7d &&
+			    packet[3] == SYSEX_ID) ? 3 : 0;
+		return sysexPos != 0;
+	}
+	if (!sysexPos)
+		return 0;
+	n = (cin == 0x04 || cin == 0x07) ? 3 : cin - 0x04;
+	for (i = 1; i <= n; i++) {
+		if (packet[i] == 0xf7) {
+			sysexPos = 0;
+			if (sysexDirty) {
+				sysexDirty = 0;
+				writeDone();
+			}
+			break;
+		}
+		sysexByte(packet[i]);
+	}
+	return 1;
+}
@@ -0,0 +1,105 @@
+/* Name: config.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __config_h_included__
+#define __config_h_included__
+
+/*
+General Description:
+Settings that survive a power cycle. All of them live in one versioned
+block, config_t, which is mirrored in RAM: code reads the settings from
+the shadow and never waits for the EEPROM.
+
+The EEPROM holds CONFIG_SLOTS copies of the block, each tagged with a
+sequence number and a checksum. configInit() loads the valid copy with the
+newest sequence number, or the defaults if there is none (blank EEPROM, or
+a firmware with another CONFIG_VERSION). A save goes to the slot after the
+current one, so the cells wear evenly: every cell sees one write per
+CONFIG_SLOTS saves. The slot's data goes first and its sequence number
+and checksum last, so a save cut short by a reset leaves the previous copy
+in charge.
+
+Saving is lazy: configChanged() marks the shadow dirty and configPoll()
+writes one byte per call, only when the EEPROM is idle, so the 3.3 ms of
+each byte write never hold up the main loop or USB. A change during a save
+starts another one after it.
+
+The host reads and writes the block with RQ_READ_CONFIG and
+RQ_WRITE_CONFIG (see vendorrq.h) in as many 8 byte packets as it takes.
+There is no room for a second copy of the block, so a write goes straight
+into the shadow and marks it busy first: while configBusy is set the
+filters pass everything unchanged and the keys are silent, instead of
+acting on half written rules and zones. The block is applied in one step
+after the last packet, or CONFIG_BUSY_MS after the last packet of a write
+the host gave up on. Before its first byte a write releases the keys held
+down under the old map (keymapRelease() in keymap.h). In the rare case
+that the event queue cannot take their note offs, RQ_WRITE_CONFIG stalls
+and a configuration SysEx is dropped, with nothing written; the host
+tries again.
+
+The same write also works as a SysEx message to the DIN output, so a
+sequencer or librarian can send it without the vendor requests:
+F0 7D 6D 01 offset-high-7 offset-low-7 (hi-nibble lo-nibble)... F7
+Each data byte goes as two nibbles and lands in config_t from the offset
+on, with the shadow busy as above; the write is applied at the F7.
+configSysex() takes such messages out of the host's USB-MIDI stream,
+every other SysEx goes to DIN.
+*/
+
+#include "midicomconfig.h"
+#include "keymap.h"
+#include "filter.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+#define CONFIG_VERSION	4	/* change with the layout of config_t */
+
+typedef struct config {
+	keymapStore_t keymap;	/* see keymap.h */
+#if FILTER_RULES
+	filterRules_t filter[2];	/* FILTER_IN, FILTER_OUT */
+#endif
+} config_t;
+
+extern config_t config;
+extern volatile uchar configBusy;	/* a write is coming in, see above */
+
+void configInit(void);
+/* Loads the newest valid copy from EEPROM into the shadow.
+ */
+void configDefaults(void);
+/* Resets the shadow to the firmware defaults. Does not apply or save it.
+ */
+void configChanged(void);
+/* Applies the shadow to the modules that cache settings and schedules a
+ * save.
+ */
+uchar configPoll(void);
+/* Writes the next byte of a pending save if the EEPROM is idle, and applies
+ * a write the host gave up on. Returns 0. Call every millisecond.
+ */
+void configReadBegin(unsigned offset, unsigned len);
+/* Starts a read of the shadow for RQ_READ_CONFIG.
+ */
+uchar configRead(uchar * data, uchar len);
+/* Supplies the next chunk of the read, for usbFunctionRead().
+ */
+void configWriteBegin(unsigned offset, unsigned len);
+/* Starts a write of len bytes from offset for RQ_WRITE_CONFIG. Bytes past
+ * the end of config_t are dropped.
+ */
+uchar configWrite(uchar * data, uchar len);
+/* Takes the next chunk of the write, for usbFunctionWrite(). Returns 1
+ * after the last one, which applies the block and schedules a save.
+ */
+uchar configSysex(uchar * packet);
+/* Checks a USB-MIDI event packet from the host for the configuration
+ * SysEx. Returns 1 if the packet belongs to one and was taken, 0 if it is
+ * to go to DIN.
+ */
+
+#endif				/* __config_h_included__ */
@@ -0,0 +1,75 @@
+/* Name: crashlog.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+
+#include "crashlog.h"
+#include "midiout.h"
+#include "midiin.h"
+
+/* .noinit is left alone by the startup code, so both survive a watchdog
+ * reset. After power-on or brown-out they hold garbage until crashlogInit().
+ */
+crashLog_t crashLog __attribute__ ((section(".noinit")));
+uchar crashPhase __attribute__ ((section(".noinit")));
+static uchar crashPending __attribute__ ((section(".noinit")));
+
+void crashlogClear(void)
+{
+	memset(&crashLog, 0, sizeof(crashLog));
+}
+
+void crashlogInit(uchar resetFlags)
+{
+	uchar count;
+
+	if (resetFlags & ((1 << PORF) | (1 << BORF))) {
+		crashlogClear();
+		crashPending = 0;
+	}
+	if (resetFlags & (1 << WDRF)) {
+		count = crashLog.resetCount + 1;
+		if (!crashPending) {	/* second timeout without the interrupt */
+			crashlogClear();
+			crashLog.how = CRASH_BLOCKED;
+			crashLog.phase = crashPhase;
+		}
+		crashLog.resetCount = count;
+	}
+	crashPending = 0;
+	crashPhase = 0;
+	WDTCSR |= (1 << WDIE);	/* no timed sequence needed for WDIE */
+}
+
+/*---------------------------------------------------------------------------*/
+/* Watchdog timeout                                                          */
+/*                                                                           */
+/* Never returns, so nothing needs to be saved: the return address on top of */
+/* the stack is the code that stopped calling wdt_reset(). The hardware has  */
+/* cleared WDIE, the next timeout resets; it is shortened to get it over     */
+/* with before the host gives up on the device.                              */
+/*---------------------------------------------------------------------------*/
+
+ISR(WDT_vect, ISR_NAKED)
+{
+	uchar *sp;
+
+	asm volatile ("clr __zero_reg__");	/* may have been inside a mul */
+	sp = (uchar *) SP;
+	crashLog.pc = ((sp[1] << 8) | sp[2]) << 1;	/* words to bytes */
+	crashLog.how = CRASH_CAUGHT;
+	crashLog.phase = crashPhase;
+	crashLog.txDepth = midiOutDepth();
+	crashLog.rxDepth = midiInDepth();
+	crashLog.eventDepth = midiInEventDepth();
+	crashLog.time = timebaseNow();
+	crashPending = 1;
+	wdt_enable(WDTO_15MS);
+	for (;;)
+		;
+}
@@ -0,0 +1,63 @@
+/* Name: crashlog.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __crashlog_h_included__
+#define __crashlog_h_included__
+
+/*
+General Description:
+Watchdog forensics. The watchdog runs in interrupt-then-reset mode: the
+first timeout enters WDT_vect, which saves where the main loop was stuck
+into a record in .noinit RAM and then lets the watchdog reset the chip. The
+record survives the reset and is read back with RQ_GET_CRASH_LOG (see
+vendorrq.h) after the device enumerates again.
+
+If the hang had interrupts disabled, the interrupt cannot run and the
+second timeout resets directly. The boot code notices that and records the
+main loop phase only (it is kept in .noinit too), with how set to
+CRASH_BLOCKED.
+*/
+
+#include "timebase.h"
+
+/* main loop phases */
+#define CRASH_PHASE_USB		1	/* usbPoll() and control transfers */
+#define CRASH_PHASE_DIN_OUT	2	/* queueing host data for DIN */
+#define CRASH_PHASE_TIME	3	/* timebasePoll() */
+#define CRASH_PHASE_DIN_IN	4	/* parsing DIN input */
+#define CRASH_PHASE_KEYS	5	/* input scanning */
+#define CRASH_PHASE_SEND	6	/* filling the interrupt-in endpoint */
+#define CRASH_PHASE_CONFIG	7	/* saving the configuration */
+
+/* crashLog.how */
+#define CRASH_NONE		0
+#define CRASH_CAUGHT		1	/* saved by the watchdog interrupt */
+#define CRASH_BLOCKED		2	/* interrupts were off, phase only */
+
+typedef struct crashLog {
+	uchar resetCount;	/* watchdog resets since power-on */
+	uchar how;		/* CRASH_* for the last watchdog reset */
+	unsigned pc;		/* byte address the watchdog interrupted */
+	uchar phase;		/* CRASH_PHASE_* */
+	uchar txDepth;		/* DIN out queue */
+	uchar rxDepth;		/* DIN in byte queue */
+	uchar eventDepth;	/* interrupt-in event queue */
+	timebase_t time;	/* device time of the timeout, 1/256 ms */
+} crashLog_t;
+
+extern crashLog_t crashLog;
+extern uchar crashPhase;
+
+#define crashlogPhase(p)	(crashPhase = (p))
+
+void crashlogInit(uchar resetFlags);
+/* Validates the record against the reset cause (MCUSR) and switches the
+ * watchdog to interrupt-then-reset. Call after wdt_enable().
+ */
+void crashlogClear(void);
+/* Forgets the last record and the reset counter.
+ */
+
+#endif				/* __crashlog_h_included__ */
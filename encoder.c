@@ -0,0 +1,104 @@
+/* Name: encoder.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "encoder.h"
+#include "midiin.h"
+#include "usbsafe.h"
+
+#if ENC_COUNT
+
+#define ENC_MASK	((uchar) (3 << ENC_FIRST_PIN))
+#if ENC_COUNT > 1
+#error "one encoder at most: PD5..PD7 are the only free pin change pins"
+#endif
+#if ENC_FIRST_PIN < 5 || ENC_FIRST_PIN > 6
+#error "the encoder must be on PD5/PD6 or PD6/PD7"
+#endif
+#if (ANALOG_COUNT && ANALOG_MUX) || TRAVEL_KEYS
+#error "encoder pins are the 4051 select lines"
+#endif
+
+/* previous AB << 2 | current AB to steps, invalid jumps count 0 */
+static PROGMEM const signed char quadTable[16] = {
+	0, -1, 1, 0,
+	1, 0, 0, -1,
+	-1, 0, 0, 1,
+	0, 1, -1, 0
+};
+
+/* detents per poll to multiplier */
+static PROGMEM const uchar accelCurve[8] = { 0, 1, 2, 3, 4, 6, 8, 10 };
+
+static uchar encPins;		/* AB, interrupt only */
+static volatile uchar encSteps;	/* interrupt only, wraps */
+static uchar encTaken;		/* steps handed out, main only */
+
+void encoderInit(void)
+{
+	DDRD &= ~ENC_MASK;
+	PORTD |= ENC_MASK;
+	encPins = (PIND >> ENC_FIRST_PIN) & 3;
+	PCMSK2 = ENC_MASK;
+	PCICR |= (1 << PCIE2);
+}
+
+uchar encoderPoll(void)
+{
+	signed char d;
+	uchar n, v;
+
+	d = (signed char) (encSteps - encTaken) / ENC_STEPS;
+	if (!d)
+		return 0;
+	n = (d < 0) ? -d : d;
+	v = n * pgm_read_byte(&accelCurve[n < 8 ? n : 7]);
+	if (v > 63)
+		v = 63;
+#if ENC_RELATIVE == ENC_TWOS
+	v = (d < 0) ? (uchar) -v & 0x7f : v;
+#else
+	v = (d < 0) ? 64 - v : 64 + v;
+#endif
+	if (!midiInPut(0x0b, 0xb0 | ENC_CHANNEL, ENC_CC, v))
+		return 1;
+	encTaken += d * ENC_STEPS;	/* the remainder stays */
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Pin change on PORTD                                                       */
+/*                                                                           */
+/* The stub masks PCIE2 and enables interrupts for V-USB first (see          */
+/* usbsafe.h), so the body never runs twice at once. An edge during the body */
+/* sets the flag again and is taken on the way out. Pins that did not change */
+/* look up a 0 step.                                                         */
+/*---------------------------------------------------------------------------*/
+
+USB_SAFE_BODY(pinInterrupt)
+{
+	uchar pins = (PIND >> ENC_FIRST_PIN) & 3;
+
+	encSteps += pgm_read_byte(&quadTable[encPins << 2 | pins]);
+	encPins = pins;
+	return 1;
+}
+
+USB_SAFE_ISR_MASKED(PCINT2_vect, PCICR, PCIE2, pinInterrupt)
+
+#else				/* ENC_COUNT */
+
+void encoderInit(void)
+{
+}
+
+uchar encoderPoll(void)
+{
+	return 0;
+}
+
+#endif				/* ENC_COUNT */
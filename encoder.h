@@ -0,0 +1,42 @@
+/* Name: encoder.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __encoder_h_included__
+#define __encoder_h_included__
+
+/*
+General Description:
+A rotary encoder as a relative controller. There is room for one: A on
+PD(ENC_FIRST_PIN) and B on the pin above, with pull-ups, within PD5..PD7,
+the pin change pins that neither USB nor the USART use. The pin change
+interrupt looks up the previous and current A/B state in a 16 entry table
+and adds -1, 0 or +1 to a count; an edge costs about 15 cycles and bounces
+cancel out.
+
+encoderPoll() runs every ENC_INTERVAL ms and takes whole detents
+(ENC_STEPS quadrature steps each) since the last run. The detents are
+multiplied by an acceleration curve of the spin speed and sent as one
+relative CC (ENC_CC on ENC_CHANNEL), however many detents went by: fast
+spins cost one event per poll, not one per detent.
+ENC_RELATIVE selects the encoding of the value:
+ENC_TWOS	two's complement: 1..63 up, 127..65 down.
+ENC_OFFSET	binary offset: 65..127 up, 63..1 down.
+*/
+
+#include "midicomconfig.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+void encoderInit(void);
+/* Enables the pull-ups and the pin change interrupt.
+ */
+uchar encoderPoll(void);
+/* Queues relative CCs for the turns since the last call. Returns non-zero
+ * if the event queue was full.
+ */
+
+#endif				/* __encoder_h_included__ */
@@ -0,0 +1,59 @@
+/* Name: filter.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <string.h>
+#include <avr/io.h>
+
+#include "filter.h"
+#include "config.h"
+
+#if FILTER_RULES
+
+static uchar sysexDrop[2];	/* per direction: drop the SysEx under way */
+
+void filterDefaults(filterRules_t * r)
+{
+	uchar c;
+
+	memset(r, 0, sizeof(*r));
+	r->noteHigh = 127;
+	for (c = 0; c < 16; c++)
+		r->channel[c] = c;
+}
+
+uchar filterPacket(uchar dir, uchar * packet)
+{
+	filterRules_t *r = &config.filter[dir];
+	uchar cin = packet[0] & 0x0f, s = packet[1], c;
+	int note;
+
+	if (cin < 0x08 || cin == 0x0f) {
+		if (s == 0xf0)
+			sysexDrop[dir] = !configBusy &&
+			    filterBit(r->system, 0);
+		else if (cin >= 0x04 && cin <= 0x07 && (s < 0xf1 || s == 0xf7))
+			return !sysexDrop[dir];	/* SysEx continued or ended */
+		return configBusy || !filterBit(r->system, s & 0x0f);
+	}
+	if (s < 0x80 || s >= 0xf0)
+		return 0;	/* not a channel message, whatever the CIN */
+	if (configBusy)
+		return 1;	/* the rules are being written */
+	c = s & 0x0f;
+	if (filterBit(r->block[(s >> 4) - 8], c))
+		return 0;
+	if (s < 0xb0 && filterBit(r->notes, c)) {
+		if (packet[2] < r->noteLow || packet[2] > r->noteHigh)
+			return 0;
+		note = packet[2] + r->transpose;
+		if (note < 0 || note > 127)
+			return 0;
+		packet[2] = note;
+	}
+	packet[1] = (s & 0xf0) | (r->channel[c] & 0x0f);
+	return 1;
+}
+
+#endif				/* FILTER_RULES */
@@ -0,0 +1,70 @@
+/* Name: filter.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __filter_h_included__
+#define __filter_h_included__
+
+/*
+General Description:
+On-device filter and transform for both data paths: FILTER_IN for DIN to
+USB (applied as midiInPoll() parses, realtime bytes in the receive
+interrupt) and FILTER_OUT for USB to DIN (host packets and scheduled
+events). Each direction has a rule table in the configuration (config.h),
+so rules come from EEPROM at boot and change with RQ_WRITE_CONFIG or the
+configuration SysEx. While such a write is coming in (configBusy) both
+directions pass everything unchanged.
+
+A rule table is lookups only, so a message costs the same whatever the
+rules: about 40 cycles for a channel message, a bit test for the rest.
+block		bit c of block[s - 8] drops status nibble s on channel c.
+system		bit n drops status 0xf0 + n; 0xf0 drops a whole SysEx.
+notes		channels whose note on, note off and poly pressure are
+		limited to noteLow..noteHigh and then moved by transpose.
+		Notes outside the range, or moved out of 0..127, are
+		dropped: two tables with adjacent ranges make a split.
+channel		the channel a message leaves on, after the note rules.
+*/
+
+#include "midicomconfig.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+#define FILTER_IN	0	/* DIN to USB */
+#define FILTER_OUT	1	/* USB to DIN */
+
+typedef struct filterRules {
+	uchar block[7][2];	/* 0x8n..0xen, bit per channel */
+	uchar system[2];	/* 0xf0..0xff */
+	uchar notes[2];		/* bit per channel */
+	signed char transpose;
+	uchar noteLow;
+	uchar noteHigh;
+	uchar channel[16];
+} filterRules_t;
+
+#define filterBit(map, i)	((map)[(i) >> 3] & (1 << ((i) & 7)))
+
+#if FILTER_RULES
+void filterDefaults(filterRules_t * r);
+/* Lets everything through unchanged.
+ */
+uchar filterPacket(uchar dir, uchar * packet);
+/* Applies the rules of dir to a 4 byte USB-MIDI event packet in place.
+ * Returns 0 if the packet is to be dropped.
+ */
+#define filterSystem(dir, c)	(!configBusy && \
+				 filterBit(config.filter[dir].system, \
+					   (c) & 0x0f))
+/* Non-zero if system byte c is blocked, for the receive interrupt. Needs
+ * config.h.
+ */
+#else
+#define filterPacket(dir, packet)	1
+#define filterSystem(dir, c)		0
+#endif
+
+#endif				/* __filter_h_included__ */
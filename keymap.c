@@ -0,0 +1,143 @@
+/* Name: keymap.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "keymap.h"
+#include "config.h"
+#include "midiin.h"
+#include "keys.h"
+#include "travel.h"
+
+uchar keymapNote[KEYMAP_KEYS];
+static signed char velocityOffset;
+
+#if KEYMAP_LAYOUT == KEYMAP_CUSTOM
+static PROGMEM const uchar keymapFlash[KEYMAP_KEYS] = { KEYMAP_NOTES };
+#else
+
+/* Default note of key i. Entries past KEYMAP_KEYS fill the last row. */
+#if KEYMAP_LAYOUT == KEYMAP_WHITE
+#define DIGITAL(i)	(KEYS_BASE_NOTE + 12 * ((i) / 7) + \
+			 2 * ((i) % 7) - ((i) % 7 > 2))
+#else
+#define DIGITAL(i)	(KEYS_BASE_NOTE + (i))
+#endif
+#define NOTE(i)		((i) < KEYS_COUNT ? DIGITAL(i) : \
+			 TRAVEL_BASE_NOTE + (i) - KEYS_COUNT)
+#define ENTRY(i)	(NOTE(i) < 128 ? NOTE(i) : KEYMAP_OFF)
+
+#define ROW8(i)		ENTRY(i), ENTRY(i + 1), ENTRY(i + 2), ENTRY(i + 3), \
+			ENTRY(i + 4), ENTRY(i + 5), ENTRY(i + 6), ENTRY(i + 7)
+#define ROW32(i)	ROW8(i), ROW8(i + 8), ROW8(i + 16), ROW8(i + 24)
+
+static PROGMEM const uchar keymapFlash[(KEYMAP_KEYS + 31) & ~31] = {
+	ROW32(0),
+#if KEYMAP_KEYS > 32
+	ROW32(32),
+#endif
+#if KEYMAP_KEYS > 64
+	ROW32(64),
+#endif
+#if KEYMAP_KEYS > 96
+	ROW32(96),
+#endif
+};
+#endif				/* KEYMAP_LAYOUT */
+
+void keymapLoad(void)
+{
+	keymapStore_t *s = &config.keymap;
+	uchar k, n;
+	int note;
+
+	velocityOffset = s->velocity;
+	for (k = 0; k < KEYMAP_KEYS; k++) {
+		n = s->note[k];
+		if (n == KEYMAP_DEFAULT)
+			n = pgm_read_byte(&keymapFlash[k]);
+		note = n + s->transpose;
+		keymapNote[k] = (n & 0x80 || note < 0 || note > 127) ?
+		    KEYMAP_OFF : note;
+	}
+}
+
+uchar keymapVelocity(uchar v)
+{
+	int x = v + velocityOffset;
+
+	return (x < 1) ? 1 : (x > 127) ? 127 : x;
+}
+
+/* Fills events with cin for note in every zone that holds it, returns
+ * their number.
+ */
+static uchar zoneEvents(uchar * events, uchar cin, uchar note, uchar v)
+{
+	uchar *e = events, z;
+	keymapZone_t *zone = config.keymap.zone;
+	int n;
+
+	for (z = 0; z < KEYMAP_ZONES; z++, zone++) {
+		if (note < zone->low || note > zone->high)
+			continue;
+		n = note + zone->transpose;
+		if (n < 0 || n > 127)
+			continue;
+		e[0] = cin;
+		e[1] = (cin << 4) | (zone->channel & 0x0f);
+		e[2] = n;
+		e[3] = v;
+		e += 4;
+	}
+	return (e - events) / 4;
+}
+
+uchar keymapPut(uchar cin, uchar key, uchar v, timestamp_t t)
+{
+	uchar events[KEYMAP_ZONES * 4], note = keymapNote[key];
+
+	if ((note & KEYMAP_OFF) || configBusy)	/* zones being written */
+		return 1;
+	return midiInPutGroup(events, zoneEvents(events, cin, note, v), t);
+}
+
+static uchar keyDown(uchar key)
+{
+#if TRAVEL_KEYS
+	if (key >= KEYS_COUNT)
+		return travelDown(key - KEYS_COUNT);
+#endif
+	return keysDown(key);
+}
+
+/* Counts the note offs of the keys held down, or queues them. */
+static unsigned noteOffs(uchar put, timestamp_t t)
+{
+	uchar events[KEYMAP_ZONES * 4], k, note, n;
+	unsigned count = 0;
+
+	for (k = 0; k < KEYMAP_KEYS; k++) {
+		note = keymapNote[k];
+		if ((note & KEYMAP_OFF) || !keyDown(k))
+			continue;
+		n = zoneEvents(events, 0x08, note, 0);
+		if (put)
+			midiInPutGroup(events, n, t);
+		count += n;
+	}
+	return count;
+}
+
+uchar keymapRelease(void)
+{
+	if (configBusy)		/* released when the write began */
+		return 1;
+	if (noteOffs(0, 0) > MIDIIN_EVENT_SIZE - 1 - midiInEventDepth())
+		return 0;
+	noteOffs(1, timebaseStamp());
+	return 1;
+}
@@ -0,0 +1,94 @@
+/* Name: keymap.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __keymap_h_included__
+#define __keymap_h_included__
+
+/*
+General Description:
+Note, channel and velocity of every key in one table. Keys are numbered
+digital keys first (keys.h, 0 .. KEYS_COUNT - 1), then travel keys
+(travel.h). Their default notes are a table in flash that the preprocessor
+builds from KEYMAP_LAYOUT in midicomconfig.h:
+KEYMAP_CHROMATIC	KEYS_BASE_NOTE + key.
+KEYMAP_WHITE		the white keys upwards from KEYS_BASE_NOTE, a C.
+KEYMAP_CUSTOM		the notes listed in KEYMAP_NOTES, one per key.
+Travel keys are a real keyboard and always chromatic from TRAVEL_BASE_NOTE.
+
+keymapLoad() copies the table to RAM, replacing entries with the user
+map from the configuration store (keymapStore_t in config.h) where it has
+one, and adds the transpose to every entry, so an event costs one load:
+keymapNote[key]. Notes moved out of 0..127 by the transpose become
+KEYMAP_OFF and the key is silent.
+
+The note then picks the zones it plays in: every zone whose low..high
+holds the note sends it on the zone's channel with the zone's transpose.
+Zones that overlap are layers, zones side by side are a split. A key
+event becomes one event per zone, queued together with one stamp by
+midiInPutGroup(), so a layer costs no extra latency: two zones share one
+interrupt-in packet. The default is one zone over all notes on
+KEYMAP_CHANNEL.
+*/
+
+#include "midicomconfig.h"
+#include "timebase.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+#define KEYMAP_KEYS	(KEYS_COUNT + TRAVEL_KEYS)
+#define KEYMAP_OFF	0x80	/* silent key */
+#define KEYMAP_DEFAULT	0xff	/* stored note: take the flash table */
+#define KEYMAP_ZONE_OFF	0xff	/* low note of an unused zone */
+
+#if KEYMAP_KEYS > 128
+#error "keymap: at most 128 keys"
+#endif
+#if KEYMAP_ZONES < 1 || KEYMAP_ZONES >= MIDIIN_EVENT_SIZE
+#error "keymap: KEYMAP_ZONES must be 1 .. MIDIIN_EVENT_SIZE - 1"
+#endif
+
+typedef struct keymapZone {
+	uchar low;		/* lowest note, KEYMAP_ZONE_OFF: unused */
+	uchar high;		/* highest note */
+	uchar channel;		/* MIDI channel - 1 */
+	signed char transpose;	/* semitones, on top of the global one */
+} keymapZone_t;
+
+typedef struct keymapStore {
+	signed char transpose;	/* semitones */
+	signed char velocity;	/* added to note on velocities */
+	keymapZone_t zone[KEYMAP_ZONES];
+	uchar note[KEYMAP_KEYS];	/* KEYMAP_DEFAULT or a note */
+} keymapStore_t;
+
+extern uchar keymapNote[KEYMAP_KEYS];	/* note per key or KEYMAP_OFF */
+
+void keymapLoad(void);
+/* Builds the RAM map from flash and the configuration. Call
+ * keymapRelease() before the configuration changes.
+ */
+uchar keymapRelease(void);
+/* Queues a note off for every key held down, in every zone of its note
+ * under the map and zones in force, so no note hangs when they change.
+ * A key that stays down sounds again when it is struck again, and its
+ * own note off later goes to a note that is already off. Returns 0 and
+ * queues nothing if the event queue has no room for all of them, 1
+ * otherwise; keys are silent while a configuration write comes in, so
+ * there is nothing to release then.
+ */
+uchar keymapVelocity(uchar v);
+/* Adds the velocity offset to a note on velocity, limited to 1..127.
+ */
+uchar keymapPut(uchar cin, uchar key, uchar v, timestamp_t t);
+/* Queues note on (cin 0x09), note off (0x08) or poly pressure (0x0a)
+ * with third byte v for key in every zone that holds its note. Returns 0
+ * if the event queue has no room for all of them, 1 if they were queued
+ * or the key is silent, as all keys are while a configuration write is
+ * coming in.
+ */
+
+#endif				/* __keymap_h_included__ */
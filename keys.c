@@ -0,0 +1,251 @@
+/* Name: keys.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <string.h>
+#include <avr/io.h>
+
+#include "keys.h"
+#include "keymap.h"
+#include "timebase.h"
+#include "usbsafe.h"
+
+/* bit n of byte i is key keyIndex(i, n) */
+static uchar keyState[KEYS_BYTES];	/* state the host has been told */
+
+#if KEYS_WAKE
+#if KEYS_DRIVER != KEYS_PINS
+#error "KEYS_WAKE needs KEYS_PINS"
+#endif
+static volatile uchar keysWake;	/* a key pin changed, set by PCINT0 */
+static uchar keysBurst;		/* polls left before going idle */
+static uchar keyPrev[KEYS_BYTES];	/* previous scan, for the debounce */
+#endif
+
+#if KEYS_DRIVER == KEYS_PINS
+#if KEYS_COUNT > 6
+#error "KEYS_PINS has at most six keys"
+#endif
+
+#define keyIndex(i, n)	(n)
+#define keyByte(k)	0
+#define keyBit(k)	(k)
+
+void keysInit(void)
+{
+	PORTB = 0xff;		/* activate all pull-ups */
+	DDRB = 0;		/* all pins input */
+#if KEYS_WAKE
+	PCMSK0 = (1 << KEYS_COUNT) - 1;
+	keysWake = 1;		/* one burst to pick up keys held at reset */
+#endif
+}
+
+static uchar scan(uchar * bits, timestamp_t * t)
+{
+	bits[0] = ~PINB & ((1 << KEYS_COUNT) - 1);
+	*t = timebaseStamp();
+	return 1;
+}
+
+#elif KEYS_DRIVER == KEYS_HC165
+#if KEYS_COUNT % 8
+#error "KEYS_HC165 needs a multiple of 8 keys"
+#endif
+
+#define keyIndex(i, n)	((i) * 8 + (n))
+#define keyByte(k)	((k) >> 3)
+#define keyBit(k)	((k) & 7)
+
+void keysInit(void)
+{
+	PORTB = 0xff & ~((1 << PB3) | (1 << PB5));	/* pull-ups on spare pins */
+	DDRB = (1 << PB2) | (1 << PB3) | (1 << PB5);	/* SH/LD high, MOSI, SCK */
+	SPCR = (1 << SPE) | (1 << MSTR) | (1 << DORD);	/* mode 0, key 0 in bit 0 */
+	SPSR = (1 << SPI2X);	/* F_CPU / 2 */
+}
+
+static uchar scan(uchar * bits, timestamp_t * t)
+{
+	uchar i;
+
+	*t = timebaseStamp();
+	PORTB &= ~(1 << PB2);	/* load the parallel inputs */
+	PORTB |= (1 << PB2);
+	for (i = 0; i < KEYS_BYTES; i++) {
+		SPDR = 0;
+		while (!(SPSR & (1 << SPIF)))
+			;
+		bits[i] = ~SPDR;
+	}
+	return 1;
+}
+
+#elif KEYS_DRIVER == KEYS_MATRIX
+#if KEYS_ROWS > 6 || KEYS_COLS > 6
+#error "KEYS_MATRIX has at most 6 rows (PC0..PC5) and 6 columns (PB0..PB5)"
+#endif
+
+#define ROW_DDR		DDRC
+#define ROW_PORT	PORTC
+#define COL_PIN		PINB
+#define COL_PORT	PORTB
+#define COL_DDR		DDRB
+#define COL_MASK	((uchar) ((1 << KEYS_COLS) - 1))
+
+/* Timer2 CTC at F_CPU / 8, one row per compare */
+#define MATRIX_OCR	(F_CPU / 8 / (KEYS_SCAN_HZ * KEYS_ROWS) - 1)
+#if MATRIX_OCR > 255
+#error "KEYS_SCAN_HZ too low for Timer2"
+#endif
+
+#define keyIndex(i, n)	((i) * KEYS_COLS + (n))
+#define keyByte(k)	((k) / KEYS_COLS)
+#define keyBit(k)	((k) % KEYS_COLS)
+
+static uchar matrixScan[KEYS_ROWS];	/* rows of the scan in progress */
+static uchar matrixFrame[KEYS_ROWS];	/* last complete scan, for main */
+static timestamp_t matrixTime;		/* when matrixFrame was completed */
+static volatile uchar matrixReady;	/* matrixFrame is new, main's turn */
+static uchar matrixRow;
+
+void keysInit(void)
+{
+	ROW_PORT &= ~((1 << KEYS_ROWS) - 1);	/* rows open drain: low or off */
+	ROW_DDR = (ROW_DDR & ~((1 << KEYS_ROWS) - 1)) | 1;
+	COL_DDR &= ~COL_MASK;
+	COL_PORT |= COL_MASK;	/* column pull-ups */
+	matrixRow = 0;
+	OCR2A = MATRIX_OCR;
+	TCCR2A = (1 << WGM21);	/* CTC */
+	TCCR2B = (1 << CS21);	/* F_CPU / 8 */
+	TIMSK2 = (1 << OCIE2A);
+}
+
+static uchar scan(uchar * bits, timestamp_t * t)
+{
+	if (!matrixReady)
+		return 0;
+	memcpy(bits, matrixFrame, KEYS_ROWS);
+	*t = matrixTime;
+	matrixReady = 0;
+	return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Timer2 compare A: matrix row strobe                                       */
+/*                                                                           */
+/* Reads the row driven at the previous tick, so each row settles for a      */
+/* whole tick without a delay loop, and drives the next one. About 50        */
+/* cycles per row; a complete scan is handed to main when it has taken the   */
+/* previous one. Each key connects its column to its row through a diode,    */
+/* so any combination of keys reads without ghosts.                          */
+/*---------------------------------------------------------------------------*/
+
+USB_SAFE_ISR(TIMER2_COMPA_vect)
+{
+	uchar r = matrixRow;
+
+	matrixScan[r] = ~COL_PIN & COL_MASK;
+	ROW_DDR &= ~(1 << r);
+	if (++r == KEYS_ROWS) {
+		r = 0;
+		if (!matrixReady) {
+			memcpy(matrixFrame, matrixScan, KEYS_ROWS);
+			matrixTime = timebaseStamp();
+			matrixReady = 1;
+		}
+	}
+	ROW_DDR |= (1 << r);
+	matrixRow = r;
+}
+
+#else
+#error "unknown KEYS_DRIVER"
+#endif
+
+#if KEYS_WAKE
+/*---------------------------------------------------------------------------*/
+/* Pin change on the key pins                                                */
+/*                                                                           */
+/* The first edge masks the interrupt again, so contact bounce costs one     */
+/* call. keysPoll() scans until the keys have been quiet for KEYS_BURST ms.  */
+/*---------------------------------------------------------------------------*/
+
+USB_SAFE_ISR(PCINT0_vect)
+{
+	PCICR &= ~(1 << PCIE0);
+	keysWake = 1;
+}
+
+/* Called after a quiet burst: rearms the pin change interrupt and checks
+ * that nothing changed since the last scan, which the flag cleared here
+ * would have hidden.
+ */
+static void keysIdle(void)
+{
+	PCIFR = (1 << PCIF0);	/* edges of the burst */
+	PCICR |= (1 << PCIE0);
+	if ((~PINB & ((1 << KEYS_COUNT) - 1)) != keyPrev[0])
+		keysWake = 1;
+}
+
+uchar keysQuiet(void)
+{
+	return !keysWake && !keysBurst;
+}
+#endif
+
+uchar keysDown(uchar key)
+{
+	return keyState[keyByte(key)] & (1 << keyBit(key));
+}
+
+uchar keysPoll(void)
+{
+	uchar bits[KEYS_BYTES];
+	uchar i, n, diff, mask, sent = 0;
+	timestamp_t t;
+
+#if KEYS_WAKE
+	if (keysWake) {
+		keysWake = 0;
+		keysBurst = KEYS_BURST;
+	} else if (!keysBurst) {
+		return 0;	/* quiet, PINB is not even read */
+	}
+#endif
+	if (!scan(bits, &t))
+		return 0;
+	for (i = 0; i < KEYS_BYTES; i++) {
+		diff = bits[i] ^ keyState[i];
+#if KEYS_WAKE
+		if (diff)
+			keysBurst = KEYS_BURST;
+		diff &= ~(bits[i] ^ keyPrev[i]);	/* same in two scans */
+		keyPrev[i] = bits[i];
+#endif
+		if (!diff)
+			continue;
+		for (n = 0, mask = 1; mask; n++, mask <<= 1) {
+			if (!(diff & mask))
+				continue;
+			if (bits[i] & mask) {
+				if (!keymapPut(0x09, keyIndex(i, n),
+					       keymapVelocity(0x7f), t))
+					return sent;	/* queue full, retry next scan */
+			} else {
+				if (!keymapPut(0x08, keyIndex(i, n), 0x00, t))
+					return sent;
+			}
+			keyState[i] ^= mask;
+			sent = 1;
+		}
+	}
+#if KEYS_WAKE
+	if (!--keysBurst)
+		keysIdle();
+#endif
+	return sent;
+}
@@ -0,0 +1,71 @@
+/* Name: keys.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __keys_h_included__
+#define __keys_h_included__
+
+/*
+General Description:
+Key inputs. A driver reads all keys into a bitmask (1 = pressed), which is
+compared with the previous scan; every changed bit becomes a note on or
+note off in the interrupt-in event queue (see midiin.h), with the notes
+and channels from the key map and its zones (keymap.h). A bit only takes
+its new state once its events are queued, so a full queue delays events but
+never loses them.
+
+Drivers, selected with KEYS_DRIVER in midicomconfig.h:
+KEYS_PINS	up to six keys on PB0..PB5, active low, the demo board.
+KEYS_HC165	chained 74HC165 shift registers on the SPI port, 8 keys per
+		chip: SH/LD on PB2 (SS), CLK on PB5 (SCK), QH of the chip
+		nearest to the controller on PB4 (MISO), CLK INH to ground.
+		Key 0 is input D7 of the nearest chip. Clocked at F_CPU / 2,
+		64 keys take about 15 us. Keys pull their input low.
+KEYS_MATRIX	diode matrix: rows on PC0..PC5 (driven low one at a time),
+		columns on PB0..PB5 with pull-ups, diode cathodes towards
+		the rows. At most 6 x 6 = 36 keys: PC6 is RESET and PB6/PB7
+		carry the crystal. The Timer2 compare interrupt strobes one
+		row per tick, KEYS_SCAN_HZ complete scans per second; a 6 x 6
+		matrix at 1 kHz costs about 3% of the CPU. Takes PORTC from
+		the debug LEDs.
+
+Events carry the time of the scan that saw the change, not the time they
+were queued.
+
+With KEYS_WAKE (KEYS_PINS only) the keys are not polled while they are
+quiet: a pin change interrupt starts a burst of scans, one per keysPoll(),
+that lasts until no key has changed for KEYS_BURST polls. During the burst
+a change is only taken once two scans in a row agree, which also debounces
+the contacts. An idle poll costs a flag test.
+*/
+
+#include "midicomconfig.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+#if KEYS_DRIVER == KEYS_MATRIX
+#define KEYS_BYTES	KEYS_ROWS	/* a byte per row, KEYS_COLS bits */
+#else
+#define KEYS_BYTES	((KEYS_COUNT + 7) / 8)
+#endif
+
+void keysInit(void);
+/* Sets up the pins (and SPI or Timer2) of the driver.
+ */
+uchar keysPoll(void);
+/* Scans the keys and queues events for the changes. Returns non-zero if any
+ * event was queued.
+ */
+uchar keysDown(uchar key);
+/* Non-zero if the last event queued for key was its note on.
+ */
+#if KEYS_WAKE
+uchar keysQuiet(void);
+/* Non-zero between bursts, while only a pin change can bring news.
+ */
+#endif
+
+#endif				/* __keys_h_included__ */
@@ -20,14 +20,32 @@
 #include "usbdrv.h"
 #include "oddebug.h"
 
+#include "midicomconfig.h"
 #include "usbdescriptor.h"
+#include "midiout.h"
+#include "midiin.h"
+#include "timebase.h"
+#include "crashlog.h"
+#include "tasks.h"
+#include "keys.h"
+#include "analog.h"
+#include "travel.h"
+#include "encoder.h"
+#include "keymap.h"
+#include "config.h"
+#include "power.h"
+#include "ramplan.h"
+#include "vendorrq.h"
 
 //---------------------------------------------------------------------------
 // Pin definitions
 
-#define BTN_PORT PORTB
-#define BTN0_PIN PB0
+#if LEDS_DEBUG
 #define LED_PORT PORTC
+#else
+static uchar ledShadow;		/* PORTC belongs to the key matrix or ADC */
+#define LED_PORT ledShadow
+#endif
 #define LED0_PIN PC0
 #define LED1_PIN PC1
 #define LED2_PIN PC2
@@ -56,30 +74,12 @@ void USART_Init( unsigned int ubrr)
     /*Set baud rate */
     UBRR0H = (unsigned char)(ubrr>>8);
     UBRR0L = (unsigned char)ubrr;
-    /* Enable receiver and transmitter */
-    UCSR0B = (1<<RXEN0)|(1<<TXEN0);
+    /* Enable receiver, the transmitter belongs to midiOutInit() */
+    UCSR0B = (1<<RXEN0);
     /* Set frame format: 8data, 2stop bit */
     UCSR0C = (1<<USBS0)|(3<<UCSZ00);
 }
 
-void USART_Transmit( unsigned char data )
-{
-    /* Wait for empty transmit buffer */
-    while ( !( UCSR0A & (1<<UDRE0)) )
-    ;
-    /* Put data into buffer, sends the data */
-    UDR0 = data;
-}
-
-unsigned char USART_Receive( void )
-{
-    /* Wait for data to be received */
-    while ( !(UCSR0A & (1<<RXC0)) )
-    ;
-    /* Get and return received data from buffer */
-    return UDR0;
-}
-
 uchar usbFunctionDescriptor(usbRequest_t * rq)
 {
 
@@ -94,12 +94,34 @@ uchar usbFunctionDescriptor(usbRequest_t * rq)
 
 
 static uchar sendEmptyFrame;
+static uchar vendorRequest;	/* bRequest served by usbFunctionRead/Write() */
+
+/* USB reset length after a reset that was not power-on */
+#define USB_RESET_TICKS	(10 * TIMEBASE_FRAME_TICKS)
+
+static struct {			/* RQ_GET_BOOT_INFO reply */
+	uchar resetFlags;	/* MCUSR at startup */
+	timebase_t addressed;	/* device time of SET_ADDRESS, 0 = not yet */
+} bootInfo;
+
+static struct {			/* RQ_GET_TIME reply */
+	timebase_t now;
+	uchar synced;
+	uchar schedFree;
+} timeReply;
 
 
 /* ------------------------------------------------------------------------- */
 /* ----------------------------- USB interface ----------------------------- */
 /* ------------------------------------------------------------------------- */
 
+/* USB_SET_ADDRESS_HOOK: time from reset to enumeration */
+void usbAddressAssigned(void)
+{
+	if (!bootInfo.addressed)
+		bootInfo.addressed = timebaseNow();
+}
+
 uchar usbFunctionSetup(uchar data[8])
 {
 	usbRequest_t *rq = (void *) data;
@@ -113,8 +135,86 @@ uchar usbFunctionSetup(uchar data[8])
 		if ((rq->bmRequestType & USBRQ_DIR_MASK) ==
 		    USBRQ_DIR_HOST_TO_DEVICE)
 			sendEmptyFrame = 1;
+	} else if ((rq->bmRequestType & USBRQ_TYPE_MASK) == USBRQ_TYPE_VENDOR) {
+		vendorRequest = rq->bRequest;
+		switch (rq->bRequest) {
+#if MIDIIN_STATS
+		case RQ_GET_IN_STATS:
+			usbMsgPtr = (uchar *) &midiInStats;
+			return sizeof(midiInStats);
+		case RQ_RESET_IN_STATS:
+			midiInStatsReset();
+			break;
+#endif
+#if MIDIIN_TIMESTAMPS
+		case RQ_SET_TIMESTAMPS:
+			midiInStampsOn = rq->wValue.bytes[0];
+			break;
+		case RQ_GET_TIMESTAMPS:
+			midiInStampsBegin(rq->wLength.word);
+			return 0xff;
+#endif
+		case RQ_GET_BOOT_INFO:
+			usbMsgPtr = (uchar *) &bootInfo;
+			return sizeof(bootInfo);
+		case RQ_GET_CRASH_LOG:
+			usbMsgPtr = (uchar *) &crashLog;
+			return sizeof(crashLog);
+		case RQ_CLEAR_CRASH_LOG:
+			crashlogClear();
+			break;
+		case RQ_GET_TASK_STATS:
+			usbMsgPtr = (uchar *) taskStats;
+			return taskCount * sizeof(taskStats_t);
+		case RQ_RESET_TASK_STATS:
+			taskStatsReset();
+			break;
+#if POWER_SLEEP
+		case RQ_GET_POWER_STATS:
+			usbMsgPtr = (uchar *) &powerStats;
+			return sizeof(powerStats);
+		case RQ_RESET_POWER_STATS:
+			powerStatsReset();
+			break;
+#endif
+		case RQ_READ_CONFIG:
+			configReadBegin(rq->wIndex.word, rq->wLength.word);
+			return 0xff;
+		case RQ_WRITE_CONFIG:
+			if (!rq->wLength.word)
+				break;
+			configWriteBegin(rq->wIndex.word, rq->wLength.word);
+			return 0xff;
+		case RQ_RESET_CONFIG:
+			if (!keymapRelease())
+				break;	/* keys held, the host tries again */
+			configDefaults();
+			configChanged();
+			break;
+		case RQ_GET_RAM_INFO:
+			ramInfoUpdate();
+			usbMsgPtr = (uchar *) &ramInfo;
+			return sizeof(ramInfo);
+		case RQ_GET_TIME:
+			timeReply.now = timebaseNow();
+			timeReply.synced = timebaseSynced();
+#if MIDIOUT_SCHED_SIZE
+			timeReply.schedFree = midiOutScheduleFree();
+#endif
+			usbMsgPtr = (uchar *) &timeReply;
+			return sizeof(timeReply);
+#if MIDIOUT_SCHED_SIZE
+		case RQ_SCHEDULE_OUT:
+			if (!rq->wLength.word)
+				break;
+			midiOutScheduleBegin(rq->wLength.word);
+			return 0xff;
+#endif
+		}
+		return 0;
 	}
 
+	vendorRequest = 0;
 	return 0xff;
 }
 
@@ -128,6 +228,15 @@ uchar usbFunctionRead(uchar * data, uchar len)
 	// DEBUG LED
 	LED_PORT ^= (1<<LED1_PIN); // never used?
 
+	switch (vendorRequest) {
+#if MIDIIN_TIMESTAMPS
+	case RQ_GET_TIMESTAMPS:
+		return midiInStampsRead(data, len);
+#endif
+	case RQ_READ_CONFIG:
+		return configRead(data, len);
+	}
+
 	data[0] = 0;
 	data[1] = 0;
 	data[2] = 0;
@@ -148,6 +257,15 @@ uchar usbFunctionWrite(uchar * data, uchar len)
 {
 	// DEBUG LED
 	LED_PORT ^= (1<<LED2_PIN); // never used?
+
+	switch (vendorRequest) {
+#if MIDIOUT_SCHED_SIZE
+	case RQ_SCHEDULE_OUT:
+		return midiOutScheduleWrite(data, len);
+#endif
+	case RQ_WRITE_CONFIG:
+		return configWrite(data, len);
+	}
 	return 1;
 }
 
@@ -163,6 +281,16 @@ void usbFunctionWriteOut(uchar * data, uchar len)
 {
 	// DEBUG LED
 	LED_PORT ^= (1<<LED3_PIN);
+
+	/* one or two 4 byte event packets, see midi10.pdf chapter 4 */
+	crashlogPhase(CRASH_PHASE_DIN_OUT);
+	while (len >= 4) {
+		if (!configSysex(data) && filterPacket(FILTER_OUT, data))
+			midiOutPacket(data);
+		data += 4;
+		len -= 4;
+	}
+	crashlogPhase(CRASH_PHASE_USB);
 }
 
 
@@ -173,82 +301,133 @@ void usbFunctionWriteOut(uchar * data, uchar len)
 
 static void hardwareInit(void)
 {
-	uchar i, j;
+	unsigned wait;
+	uchar tick, last, delta;
 
 	/* activate pull-ups except on USB lines */
 	USB_CFG_IOPORT =
 	    (uchar) ~ ((1 << USB_CFG_DMINUS_BIT) |
 		       (1 << USB_CFG_DPLUS_BIT));
-	/* all pins input except USB (-> USB reset) */
+	/* USB Reset by device only required on Watchdog, brown-out or external
+	   reset: after power-on the host has already seen us detached. */
+	wait = (bootInfo.resetFlags & (1 << PORF)) ? 0 : USB_RESET_TICKS;
+	if (wait) {
+		/* all pins input except USB (-> USB reset) */
 #ifdef USB_CFG_PULLUP_IOPORT	/* use usbDeviceConnect()/usbDeviceDisconnect() if available */
-	USBDDR = 0;		/* we do RESET by deactivating pullup */
-	usbDeviceDisconnect();
+		USBDDR = 0;	/* we do RESET by deactivating pullup */
+		usbDeviceDisconnect();
 #else
-	USBDDR = (1 << USB_CFG_DMINUS_BIT) | (1 << USB_CFG_DPLUS_BIT);
+		USBDDR = (1 << USB_CFG_DMINUS_BIT) | (1 << USB_CFG_DPLUS_BIT);
 #endif
+	}
 
-	j = 0;
-	while (--j) {		/* USB Reset by device only required on Watchdog Reset */
-		i = 0;
-		while (--i);	/* delay >10ms for USB reset */
+	/* the rest is set up while the reset runs */
+    USART_Init(MYUBRR); // init midi connection
+    midiOutInit();
+    midiInInit();
+
+	configInit();		/* settings, see config.h */
+	keymapLoad();
+	keysInit();		/* keys/switches, see keys.h */
+	analogInit();
+	travelInit();
+	encoderInit();
+	powerInit();
+#if LEDS_DEBUG
+// PORTC has up to six debug LEDs (active low).
+	PORTC = 0xff;		/* all LEDs off, pullups on the rest of the pins */
+	DDRC = 0x3f;		/* pins PC0-PC5 output */
+#endif
+
+	/* delay >10ms for USB reset, timed by Timer0 (see timebaseInit()) */
+	last = TCNT0;
+	while (wait) {
+		tick = TCNT0;
+		delta = tick - last;
+		last = tick;
+		wait = (delta < wait) ? wait - delta : 0;
+		timebasePoll();	/* keep boot time in the clock */
 	}
 #ifdef USB_CFG_PULLUP_IOPORT
 	usbDeviceConnect();
 #else
 	USBDDR = 0;		/*  remove USB reset condition */
 #endif
-
-    USART_Init(MYUBRR); // init midi connection
-
-// keys/switches setup
-// PORTB has up to six keys (active low).
-	PORTB = 0xff;		/* activate all pull-ups */
-	DDRB = 0;		/* all pins input */
-// PORTC has up to six debug LEDs (active low).
-	PORTC = 0xff;		/* all LEDs off, pullups on the rest of the pins */
-	DDRC = 0x3f;		/* pins PC0-PC5 output */
 }
 
 
 
-/* Simple monophonic keyboard
-   The following function returns a midi note value for the first key pressed. 
-   Key 0 -> 60 (middle C),
-   Key 1 -> 62 (D)
-   Key 2 -> 64 (E)
-   Key 3 -> 65 (F)
-   Key 4 -> 67 (G)
-   Key 5 -> 69 (A)
-   Key 6 -> 71 (B)
-   Key 7 -> 72 (C)
- * returns 0 if no key is pressed.
- */
-static uchar keyPressed(void)
+/*---------------------------------------------------------------------------*/
+/* Main loop tasks, see tasks.h                                              */
+/*---------------------------------------------------------------------------*/
+
+static uchar taskTime(void)
 {
-	uchar i, mask, x;
-
-	x = PINB;
-	mask = 1;
-	for (i = 0; i <= 10; i += 2) {
-		if (6 == i)
-			i--;
-		if ((x & mask) == 0)
-			return i + 60;
-		mask <<= 1;
-	}
+	timebasePoll();
 	return 0;
 }
 
+static uchar taskKeys(void)
+{
+	if (keysPoll())
+		LED_PORT ^= (1<<LED4_PIN); // blinkar när en knapp trycks in?
+	return 0;
+}
 
-
-int main(void)
+static uchar taskSend(void)
 {
-	uchar key, lastKey = 0;
-	uchar keyDidChange = 0;
 	uchar midiMsg[8];
 	uchar iii;
 
+	if (usbInterruptIsReady()) {
+		// up to two midi events in one midi msg, realtime first.
+		// For description of USB MIDI msg see:
+		// http://www.usb.org/developers/devclass_docs/midi10.pdf
+		// 4. USB MIDI Event Packets
+		iii = midiInPacket(midiMsg);
+		if (iii) {
+			if (8 == iii)
+				sendEmptyFrame = 1;
+			else
+				sendEmptyFrame = 0;
+			usbSetInterrupt(midiMsg, iii);
+		}
+	}			// usbInterruptIsReady()
+	return 0;
+}
+
+/* Free-running time needs timebasePoll() every 1.3 ms; keys are scanned
+ * once per frame, which is also their debounce interval.
+ */
+static PROGMEM const task_t tasks[] = {
+	{taskTime, 0, TASK_US(40), 3, CRASH_PHASE_TIME},
+	{taskSend, 0, TASK_US(60), 2, CRASH_PHASE_SEND},
+	{midiInPoll, 0, TASK_US(200), 1, CRASH_PHASE_DIN_IN},
+	{taskKeys, TASK_MS(1), TASK_US(60), 0, CRASH_PHASE_KEYS},
+#if ANALOG_COUNT
+	{analogPoll, TASK_MS(1), TASK_US(100), 0, CRASH_PHASE_KEYS},
+#endif
+#if TRAVEL_KEYS
+	{travelPoll, TASK_MS(1), TASK_US(150), 0, CRASH_PHASE_KEYS},
+#endif
+#if ENC_COUNT
+	{encoderPoll, TASK_MS(ENC_INTERVAL), TASK_US(40), 0, CRASH_PHASE_KEYS},
+#endif
+	{configPoll, TASK_MS(1), TASK_US(40), 0, CRASH_PHASE_CONFIG},
+#if MIDIOUT_NOTES
+	{midiOutPoll, TASK_MS(MIDIOUT_POLL_MS), TASK_US(100), 0,
+	 CRASH_PHASE_DIN_OUT},
+#endif
+};
+TASK_TABLE_CHECK(tasks);
+
+int main(void)
+{
+	bootInfo.resetFlags = MCUSR;
+	MCUSR = 0;
 	wdt_enable(WDTO_1S);
+	crashlogInit(bootInfo.resetFlags);
+	timebaseInit();
 	hardwareInit();
 	odDebugInit();
 	usbInit();
@@ -256,46 +435,7 @@ int main(void)
 	sendEmptyFrame = 0;
 
 	sei();
-	
-	for (;;) {		/* main event loop */
-		wdt_reset();
-		usbPoll();
-
-		key = keyPressed();
-		if (lastKey != key)
-			keyDidChange = 1;
-
-		if (usbInterruptIsReady()) {
-			if (keyDidChange) {
-				LED_PORT ^= (1<<LED4_PIN); // blinkar när en knapp trycks in?
-				/* use last key and not current key status in order to avoid lost
-				   changes in key status. */
-				// up to two midi events in one midi msg.
-				// For description of USB MIDI msg see:
-				// http://www.usb.org/developers/devclass_docs/midi10.pdf
-				// 4. USB MIDI Event Packets
-				iii = 0;
-				if (lastKey) {	/* release */
-					midiMsg[iii++] = 0x08; // USB: CN=Cable 0, CIN=Note-off event
-					midiMsg[iii++] = 0x80; // MIDI: Channel 0, Note-off
-					midiMsg[iii++] = lastKey; // MIDI: Key number
-					midiMsg[iii++] = 0x00; // MIDI: velocity (0=min)
-				}
-				if (key) {	/* press */
-					midiMsg[iii++] = 0x09; // USB: CN=Cable 0, CIN=Note-on event
-					midiMsg[iii++] = 0x90; // MIDI: Channel 0, Note-on
-					midiMsg[iii++] = key; // MIDI: Key number
-					midiMsg[iii++] = 0x7f; // MIDI: velocity (0x7f=max)
-				}
-				if (8 == iii)
-					sendEmptyFrame = 1;
-				else
-					sendEmptyFrame = 0;
-				usbSetInterrupt(midiMsg, iii);
-				keyDidChange = 0;
-				lastKey = key;
-			}
-		}		// usbInterruptIsReady()
-	}
+
+	taskLoop(tasks, sizeof(tasks) / sizeof(tasks[0]));
 	return 0;
 }
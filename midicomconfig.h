@@ -0,0 +1,318 @@
+/* Name: midicomconfig.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __midicomconfig_h_included__
+#define __midicomconfig_h_included__
+
+/*
+General Description:
+Queue depths, optional features and the RAM plan they add up to. Every
+buffer size lives here; a product build overrides them with -D on the
+command line. ramplan.c fails the build if the planned data plus the stack
+reserve does not fit the ATmega168's 1 KB, and "make size" checks the
+linked data against the same limit. RQ_GET_RAM_INFO (see vendorrq.h)
+reports the stack headroom actually left, to tune RAM_STACK_RESERVE.
+*/
+
+/* DIN output, midiout.c */
+#ifndef MIDIOUT_QUEUE_SIZE
+#define MIDIOUT_QUEUE_SIZE	64	/* power of two <= 256 */
+#endif
+#ifndef MIDIOUT_SCHED_SIZE
+#define MIDIOUT_SCHED_SIZE	8	/* scheduled events, 0 disables */
+#endif
+#ifndef MIDIOUT_RUNNING_STATUS
+#define MIDIOUT_RUNNING_STATUS	1	/* leave out repeated status bytes */
+#endif
+/* MIDIOUT_THIN goes by the RAM plan, see below */
+#ifndef MIDIOUT_THIN_LEVEL
+#define MIDIOUT_THIN_LEVEL	16	/* queued bytes (5 ms) to start thinning */
+#endif
+
+/* DIN input and interrupt-in events, midiin.c */
+#ifndef MIDIIN_RX_SIZE
+#define MIDIIN_RX_SIZE		32	/* raw DIN bytes, power of two <= 256 */
+#endif
+#ifndef MIDIIN_EVENT_SIZE
+#define MIDIIN_EVENT_SIZE	16	/* event packets, power of two <= 64 */
+#endif
+#ifndef MIDIIN_RT_SIZE
+#define MIDIIN_RT_SIZE		8	/* realtime lane, power of two <= 256 */
+#endif
+#ifndef MIDIIN_POLL_SLICE
+#define MIDIIN_POLL_SLICE	16	/* bytes parsed per midiInPoll() */
+#endif
+#ifndef MIDIIN_STATS
+#define MIDIIN_STATS		1	/* realtime latency measurement */
+#endif
+#ifndef MIDIIN_TIMESTAMPS
+#define MIDIIN_TIMESTAMPS	1	/* capture time side channel */
+#endif
+#ifndef MIDIIN_STAMP_SIZE
+#define MIDIIN_STAMP_SIZE	32	/* sent but unread stamps, power of two */
+#endif
+
+/* key inputs, keys.c */
+#define KEYS_PINS		0	/* PB0..PB5 */
+#define KEYS_HC165		1	/* 74HC165 chain on SPI */
+#define KEYS_MATRIX		2	/* diode matrix, rows PORTC, columns PINB */
+#ifndef KEYS_DRIVER
+#define KEYS_DRIVER		KEYS_PINS
+#endif
+#ifndef KEYS_ROWS
+#define KEYS_ROWS		6	/* matrix rows on PC0.., at most 6 */
+#endif
+#ifndef KEYS_COLS
+#define KEYS_COLS		6	/* matrix columns on PB0.., at most 6 */
+#endif
+#ifndef KEYS_SCAN_HZ
+#define KEYS_SCAN_HZ		1000	/* full matrix scans per second */
+#endif
+#ifndef KEYS_COUNT
+#if KEYS_DRIVER == KEYS_HC165
+#define KEYS_COUNT		64	/* multiple of 8 */
+#elif KEYS_DRIVER == KEYS_MATRIX
+#define KEYS_COUNT		(KEYS_ROWS * KEYS_COLS)	/* row by row */
+#else
+#define KEYS_COUNT		6
+#endif
+#endif
+#ifndef KEYS_BASE_NOTE
+#if KEYS_DRIVER == KEYS_PINS
+#define KEYS_BASE_NOTE		60	/* middle C */
+#else
+#define KEYS_BASE_NOTE		36	/* note of key 0 on a keybed */
+#endif
+#endif
+#ifndef KEYS_WAKE
+#define KEYS_WAKE		(KEYS_DRIVER == KEYS_PINS)	/* scan on pin change */
+#endif
+#ifndef KEYS_BURST
+#define KEYS_BURST		50	/* ms of scanning after the last change */
+#endif
+
+/* pots and sliders, analog.c */
+#ifndef ANALOG_COUNT
+#define ANALOG_COUNT		0	/* pots, 0 disables the ADC */
+#endif
+#ifndef ANALOG_MUX
+#define ANALOG_MUX		0	/* 4051 per ADC input, 8 pots each */
+#endif
+#ifndef ANALOG_ADC_FIRST
+#define ANALOG_ADC_FIRST	0	/* first ADC input used */
+#endif
+#ifndef ANALOG_OVERSAMPLE
+#define ANALOG_OVERSAMPLE	4	/* conversions summed, power of two */
+#endif
+/* in sum units, by output resolution, see analog.h */
+#ifndef ANALOG_HYSTERESIS
+#define ANALOG_HYSTERESIS	(ANALOG_RESOLUTION == ANALOG_CC7 ? \
+				 3 * ANALOG_OVERSAMPLE : ANALOG_OVERSAMPLE / 2)
+#endif
+#ifndef ANALOG_CHANNEL
+#define ANALOG_CHANNEL		0	/* MIDI channel - 1 */
+#endif
+#ifndef ANALOG_CC_BASE
+#define ANALOG_CC_BASE		16	/* general purpose controller 1 */
+#endif
+#define ANALOG_CC7		0	/* CC ANALOG_CC_BASE + n */
+#define ANALOG_CC14		1	/* MSB on CC base + n, LSB on base + n + 32 */
+#define ANALOG_NRPN		2	/* NRPN ANALOG_NRPN_MSB, ANALOG_CC_BASE + n */
+#ifndef ANALOG_RESOLUTION
+#define ANALOG_RESOLUTION	ANALOG_CC7
+#endif
+#ifndef ANALOG_NRPN_MSB
+#define ANALOG_NRPN_MSB		0	/* NRPN parameter number MSB */
+#endif
+#ifndef ANALOG_DIN
+#define ANALOG_DIN		0	/* also send pot events to DIN out */
+#endif
+#ifndef ANALOG_QUEUE_LIMIT
+#define ANALOG_QUEUE_LIMIT	4	/* leave the rest of the queue to keys */
+#endif
+
+/* analog keybed, travel.c */
+#ifndef TRAVEL_KEYS
+#define TRAVEL_KEYS		0	/* keys, 0 disables */
+#endif
+#ifndef TRAVEL_ADC_FIRST
+#define TRAVEL_ADC_FIRST	0	/* first ADC input (4051 common pin) */
+#endif
+#ifndef TRAVEL_ADPS
+#define TRAVEL_ADPS		4	/* ADC clock F_CPU / 16 */
+#endif
+#ifndef TRAVEL_INVERT
+#define TRAVEL_INVERT		0	/* sensor reads high at rest */
+#endif
+#ifndef TRAVEL_RELEASE
+#define TRAVEL_RELEASE		40	/* positions, 0 rest .. 255 bottom */
+#endif
+#ifndef TRAVEL_START
+#define TRAVEL_START		60
+#endif
+#ifndef TRAVEL_STRIKE
+#define TRAVEL_STRIKE		200
+#endif
+#ifndef TRAVEL_AT_DEPTH
+#define TRAVEL_AT_DEPTH		230
+#endif
+#ifndef TRAVEL_VELOCITY
+#define TRAVEL_VELOCITY		1016	/* rounds * velocity, 127 at 8 rounds */
+#endif
+#ifndef TRAVEL_AT_INTERVAL
+#define TRAVEL_AT_INTERVAL	10	/* ms between aftertouch per key */
+#endif
+#ifndef TRAVEL_BASE_NOTE
+#define TRAVEL_BASE_NOTE	KEYS_BASE_NOTE
+#endif
+
+/* note and channel of keys and travel keys, keymap.c */
+#define KEYMAP_CHROMATIC	0	/* base note + key */
+#define KEYMAP_WHITE		1	/* white keys (C major) from base note */
+#define KEYMAP_CUSTOM		2	/* KEYMAP_NOTES: list of 128 notes */
+#ifndef KEYMAP_LAYOUT
+#if KEYS_DRIVER == KEYS_PINS
+#define KEYMAP_LAYOUT		KEYMAP_WHITE
+#else
+#define KEYMAP_LAYOUT		KEYMAP_CHROMATIC
+#endif
+#endif
+#ifndef KEYMAP_CHANNEL
+#define KEYMAP_CHANNEL		0	/* MIDI channel - 1 of the default zone */
+#endif
+#ifndef KEYMAP_ZONES
+#define KEYMAP_ZONES		4	/* split and layer zones, events per key */
+#endif
+
+/* rotary encoder, encoder.c */
+#ifndef ENC_COUNT
+#define ENC_COUNT		0	/* 1 enables the encoder */
+#endif
+#ifndef ENC_FIRST_PIN
+#define ENC_FIRST_PIN		5	/* A on PD5, B on PD6; or 6 */
+#endif
+#ifndef ENC_STEPS
+#define ENC_STEPS		4	/* quadrature steps per detent */
+#endif
+#ifndef ENC_INTERVAL
+#define ENC_INTERVAL		10	/* ms between polls */
+#endif
+#define ENC_TWOS		0	/* relative CC, two's complement */
+#define ENC_OFFSET		1	/* relative CC, binary offset 64 */
+#ifndef ENC_RELATIVE
+#define ENC_RELATIVE		ENC_TWOS
+#endif
+#ifndef ENC_CHANNEL
+#define ENC_CHANNEL		0	/* MIDI channel - 1 */
+#endif
+#ifndef ENC_CC
+#define ENC_CC			80	/* general purpose controller 5 */
+#endif
+
+/* sleep and USB suspend, power.c */
+#ifndef POWER_SLEEP
+#define POWER_SLEEP		1	/* idle sleep when the main loop is idle */
+#endif
+#ifndef POWER_REMOTE_WAKEUP
+#define POWER_REMOTE_WAKEUP	POWER_SLEEP	/* keys wake a suspended host */
+#endif
+
+/* debug LEDs on PC0..PC5, off when the key matrix or the ADC needs PORTC */
+#ifndef LEDS_DEBUG
+#define LEDS_DEBUG		(KEYS_DRIVER != KEYS_MATRIX && !ANALOG_COUNT && \
+				 !TRAVEL_KEYS)
+#endif
+
+/* main loop, tasks.c */
+#ifndef TASK_MAX
+#define TASK_MAX		8	/* table entries, <= 8 */
+#endif
+
+/*---------------------------------------------------------------------------*/
+/* RAM plan in bytes                                                         */
+/*---------------------------------------------------------------------------*/
+
+#define RAM_SIZE		1024
+/* Deepest nesting: main loop calls (about 40) + Timer0 compare with the
+ * time interpolation (40) + a masked USART handler (30) + the V-USB
+ * interrupt (30), with some margin. Measure with RQ_GET_RAM_INFO.
+ */
+#ifndef RAM_STACK_RESERVE
+#define RAM_STACK_RESERVE	160
+#endif
+#define RAM_DATA_LIMIT		(RAM_SIZE - RAM_STACK_RESERVE)
+
+#define RAM_RING(size, extra)	((size) * (1 + (extra)) + 3)
+
+#define RAM_USBDRV	64	/* rx double buffer, tx buffers, driver state */
+#define RAM_MIDIOUT	(RAM_RING(MIDIOUT_QUEUE_SIZE, 0) + 2 + \
+			 (MIDIOUT_SCHED_SIZE ? MIDIOUT_SCHED_SIZE * 8 + 12 : 0))
+#define RAM_MIDIIN	(RAM_RING(MIDIIN_RX_SIZE, 2 * MIDIIN_TIMESTAMPS) + \
+			 RAM_RING(MIDIIN_RT_SIZE, \
+				  2 * (MIDIIN_STATS || MIDIIN_TIMESTAMPS)) + \
+			 RAM_RING(MIDIIN_EVENT_SIZE, 4 + 2 * MIDIIN_TIMESTAMPS) + \
+			 (MIDIIN_TIMESTAMPS ? \
+			  RAM_RING(MIDIIN_STAMP_SIZE, 1) + 7 : 0) + \
+			 (MIDIIN_STATS ? 8 : 0) + 10)
+#define RAM_KEYS	((KEYS_DRIVER == KEYS_MATRIX ? KEYS_ROWS * 3 : \
+			  (KEYS_COUNT + 7) / 8) + 4 + (KEYS_WAKE ? 3 : 0))
+#define RAM_ANALOG	(ANALOG_COUNT ? ANALOG_COUNT * \
+			 (ANALOG_RESOLUTION == ANALOG_CC7 ? 5 : 7) + 5 : 0)
+#define RAM_TRAVEL	(TRAVEL_KEYS ? TRAVEL_KEYS * 5 + 37 : 0)
+#define RAM_ENC		(ENC_COUNT ? 3 : 0)
+#define RAM_KEYMAP	(KEYS_COUNT + TRAVEL_KEYS + 1)
+#define RAM_CONFIG	(KEYS_COUNT + TRAVEL_KEYS + KEYMAP_ZONES * 4 + 18)
+#define RAM_POWER	(POWER_SLEEP ? 20 : 0)
+#define RAM_TASKS	(TASK_MAX * 4 + 2)
+#define RAM_MISC	64	/* timebase, crash log, main, debug */
+
+#define RAM_CORE	(RAM_USBDRV + RAM_MIDIOUT + RAM_MIDIIN + RAM_KEYS + \
+			 RAM_ANALOG + RAM_TRAVEL + RAM_ENC + RAM_KEYMAP + \
+			 RAM_CONFIG + RAM_POWER + RAM_TASKS + RAM_MISC)
+
+/* Optional features take what the plan leaves: each is on by default when
+ * RAM_CORE and the features before it leave room. The pins board gets all
+ * three; 64 keys on shift registers, the 6 x 6 matrix, the travel keybed
+ * or 16 multiplexed pots get some or none. Forcing a feature on where it
+ * does not fit fails the check in ramplan.c. 32 pots do not fit even
+ * without them; they need MIDIOUT_QUEUE_SIZE 32.
+ */
+
+/* note offs on DIN out when the host goes away, midiout.c */
+#define RAM_NOTES_SIZE	41
+#ifndef MIDIOUT_NOTES
+#if RAM_CORE + RAM_NOTES_SIZE <= RAM_DATA_LIMIT
+#define MIDIOUT_NOTES		1
+#else
+#define MIDIOUT_NOTES		0
+#endif
+#endif
+#define RAM_NOTES	(MIDIOUT_NOTES ? RAM_NOTES_SIZE : 0)
+
+/* controller thinning on a congested DIN output, midiout.c */
+#define RAM_THIN_ENTRY	4
+#ifndef MIDIOUT_THIN
+#if RAM_CORE + RAM_NOTES + 4 * RAM_THIN_ENTRY + 4 <= RAM_DATA_LIMIT
+#define MIDIOUT_THIN		4	/* controllers thinned at once, 0 = off */
+#else
+#define MIDIOUT_THIN		0
+#endif
+#endif
+#define RAM_THIN	(MIDIOUT_THIN ? MIDIOUT_THIN * RAM_THIN_ENTRY + 4 : 0)
+
+/* filter and transform rules for DIN in and out, filter.c */
+#define RAM_FILTER_SIZE	(2 * 37 + 2)
+#ifndef FILTER_RULES
+#if RAM_CORE + RAM_NOTES + RAM_THIN + RAM_FILTER_SIZE <= RAM_DATA_LIMIT
+#define FILTER_RULES		1
+#else
+#define FILTER_RULES		0
+#endif
+#endif
+#define RAM_FILTER	(FILTER_RULES ? RAM_FILTER_SIZE : 0)
+
+#define RAM_PLANNED	(RAM_CORE + RAM_NOTES + RAM_THIN + RAM_FILTER)
+
+#endif				/* __midicomconfig_h_included__ */
@@ -0,0 +1,411 @@
+/* Name: midiin.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "midiin.h"
+#include "timebase.h"
+#include "usbsafe.h"
+#include "ring.h"
+#include "config.h"
+
+#define RT_STAMPS	(MIDIIN_STATS || MIDIIN_TIMESTAMPS)
+
+/* raw DIN bytes: interrupt -> main */
+RING_BYTES(rx, MIDIIN_RX_SIZE)
+
+/* realtime lane: interrupt -> main */
+RING_BYTES(rt, MIDIIN_RT_SIZE)
+#if RT_STAMPS
+static timestamp_t rtTime[MIDIIN_RT_SIZE];
+#endif
+
+/* event packets: main -> main */
+RING_EVENTS(event, MIDIIN_EVENT_SIZE)
+static uchar eventGlue[MIDIIN_EVENT_SIZE];	/* first of a pair */
+static uchar glueNext;
+
+#if MIDIIN_TIMESTAMPS
+static timestamp_t rxTime[MIDIIN_RX_SIZE];
+static timestamp_t eventTime[MIDIIN_EVENT_SIZE];
+static timestamp_t msgTime;	/* first byte of the message being parsed */
+
+/* stamps of sent events: main -> host, both ends in main */
+uchar midiInStampsOn;
+RING_DEFINE(stamp, timestamp_t, MIDIIN_STAMP_SIZE)
+static uchar stampSeq;		/* sequence number of stampBuf[stampTail] */
+static uchar stampHeader;	/* read transfer still has to send its header */
+static uchar stampLeft;		/* stamps the read transfer still sends */
+#endif
+
+/* parser state */
+static uchar status;		/* running status or pending system common */
+static uchar need;		/* data bytes per message for status */
+static uchar msg[4];		/* packet under construction */
+static uchar idx;		/* next free byte in msg, 1 = nothing yet */
+static uchar inSysex;
+static uchar statusByte;	/* message started with its own status byte */
+
+#if MIDIIN_STATS
+midiInStats_t midiInStats;
+
+#define statsOverrun()	midiInStats.rxOverruns++
+
+void midiInStatsReset(void)
+{
+	memset(&midiInStats, 0, sizeof(midiInStats));
+	midiInStats.rtLatencyMin = 0xffff;
+	eventHigh = 0;
+}
+#else
+#define statsOverrun()
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+void midiInInit(void)
+{
+	rxReset();
+	rtReset();
+	eventReset();
+	status = 0;
+	idx = 1;
+	inSysex = 0;
+#if MIDIIN_STATS
+	midiInStatsReset();
+#endif
+	UCSR0B |= (1 << RXEN0) | (1 << RXCIE0);
+}
+
+#if MIDIIN_TIMESTAMPS
+static void stampSent(timestamp_t t)
+{
+	if (!midiInStampsOn)
+		return;
+	if (!stampSpace()) {	/* host is not reading, drop the oldest */
+		stampDrop();
+		stampSeq++;
+	}
+	stampPut(t);
+}
+
+void midiInStampsBegin(unsigned len)
+{
+	uchar n = stampCount();
+
+	len = (len < 2) ? 0 : (len - 2) / 2;
+	stampLeft = (len < n) ? len : n;
+	stampHeader = 1;
+}
+
+/* Format: sequence number of the first stamp, number of stamps, then the
+ * stamps little endian. The header is two bytes so every chunk but the
+ * last is a full 8 bytes: V-USB ends a control read at a short one.
+ */
+uchar midiInStampsRead(uchar * data, uchar len)
+{
+	timestamp_t *t;
+	uchar n = 0;
+
+	if (stampHeader && len >= 2) {
+		stampHeader = 0;
+		data[n++] = stampSeq;
+		data[n++] = stampLeft;
+	}
+	while (n + 2 <= len && stampLeft && (t = stampPeek())) {
+		data[n++] = (uchar) *t;
+		data[n++] = *t >> 8;
+		stampDrop();
+		stampSeq++;
+		stampLeft--;
+	}
+	return n;
+}
+#define stampEvent(t)	stampSent(t)
+#else
+#define stampEvent(t)
+#endif
+
+static uchar putEvent(uchar cin, uchar b1, uchar b2, uchar b3,
+		      timestamp_t t)
+{
+	ringEvent_t *ev;
+
+	ev = eventSlot();
+	if (!ev)
+		return 0;
+	ev->b[0] = cin;
+	ev->b[1] = b1;
+	ev->b[2] = b2;
+	ev->b[3] = b3;
+	eventGlue[eventHead] = glueNext;
+	glueNext = 0;
+#if MIDIIN_TIMESTAMPS
+	eventTime[eventHead] = t;
+#endif
+	eventCommit();
+#if MIDIIN_STATS
+	midiInStats.eventHighWater = eventHigh;
+#endif
+	return 1;
+}
+
+uchar midiInPut(uchar cin, uchar b1, uchar b2, uchar b3)
+{
+	return putEvent(cin, b1, b2, b3, timebaseStamp());
+}
+
+uchar midiInPutPair(uchar cin, uchar b1, uchar b2, uchar b3, uchar c2,
+		    uchar c3)
+{
+	timestamp_t t;
+
+	if (eventSpace() < 2)
+		return 0;
+	t = timebaseStamp();
+	glueNext = 1;
+	putEvent(cin, b1, b2, b3, t);
+	return putEvent(cin, b1, c2, c3, t);
+}
+
+uchar midiInPutGroup(uchar * events, uchar n, timestamp_t t)
+{
+	uchar i;
+
+	if (eventSpace() < n)
+		return 0;
+	for (i = 0; i < n; i++, events += 4) {
+		glueNext = !(i & 1) && i + 1 < n;
+		putEvent(events[0], events[1], events[2], events[3], t);
+	}
+	return 1;
+}
+
+#if MIDIIN_TIMESTAMPS
+#define startMessage(t)	msgTime = (t)
+#define msgStamp	msgTime
+#else
+#define startMessage(t)
+#define msgStamp	0
+#endif
+
+#if FILTER_RULES
+/* A message the rules drop counts as delivered. A message retried after a
+ * full queue is filtered again with the same result.
+ */
+static uchar putMsg(uchar cin, uchar b1, uchar b2, uchar b3)
+{
+	uchar p[4] = { cin, b1, b2, b3 };
+
+	if (!filterPacket(FILTER_IN, p))
+		return 1;
+	return putEvent(p[0], p[1], p[2], p[3], msgStamp);
+}
+#else
+#define putMsg(cin, b1, b2, b3)	putEvent(cin, b1, b2, b3, msgStamp)
+#endif
+
+/* Returns 0 if the byte could not be consumed because the event queue is
+ * full; it is then left in the byte queue for the next pass.
+ */
+static uchar parseByte(uchar c, timestamp_t t)
+{
+	uchar cin, n;
+
+	if (c & 0x80) {
+		if (c == 0xf7) {	/* end of exclusive */
+			status = 0;
+			if (!inSysex)
+				return 1;
+			cin = 0x04 + idx;	/* CIN 5, 6 or 7 */
+			msg[idx] = c;
+			for (n = idx + 1; n < 4; n++)
+				msg[n] = 0;
+			if (!putMsg(cin, msg[1], msg[2], msg[3]))
+				return 0;
+			inSysex = 0;
+			idx = 1;
+			return 1;
+		}
+		inSysex = 0;	/* any other status aborts a SysEx */
+		idx = 1;
+		statusByte = 1;
+		startMessage(t);
+		if (c == 0xf0) {
+			inSysex = 1;
+			status = 0;
+			msg[idx++] = c;
+			return 1;
+		}
+		if (c >= 0xf0) {	/* system common */
+			status = 0;
+			if (c == 0xf1 || c == 0xf3)
+				need = 1;
+			else if (c == 0xf2)
+				need = 2;
+			else if (c == 0xf6)
+				return putMsg(0x05, c, 0, 0);
+			else
+				return 1;	/* 0xf4, 0xf5 undefined */
+			status = c;
+			return 1;
+		}
+		status = c;
+		need = ((c & 0xe0) == 0xc0) ? 1 : 2;	/* program, pressure */
+		return 1;
+	}
+
+	if (inSysex) {
+		if (idx == 1)
+			startMessage(t);
+		msg[idx++] = c;
+		if (idx == 4) {
+			if (!putMsg(0x04, msg[1], msg[2], msg[3])) {
+				idx--;
+				return 0;
+			}
+			idx = 1;
+		}
+		return 1;
+	}
+	if (!status)
+		return 1;	/* stray data byte */
+	if (idx == 1) {		/* first data byte, possibly running status */
+		if (!statusByte)
+			startMessage(t);
+		statusByte = 0;
+		msg[1] = status;
+		msg[3] = 0;
+		idx = 2;
+	}
+	msg[idx++] = c;
+	if (idx - 2 < need)
+		return 1;
+	if (status >= 0xf0)
+		cin = (need == 1) ? 0x02 : 0x03;
+	else
+		cin = status >> 4;
+	if (!putMsg(cin, msg[1], msg[2], msg[3])) {
+		idx--;
+		return 0;
+	}
+	idx = 1;
+	if (status >= 0xf0)	/* no running status for system common */
+		status = 0;
+	return 1;
+}
+
+uchar midiInPoll(void)
+{
+	uchar *c, n = MIDIIN_POLL_SLICE;
+
+	while ((c = rxPeek())) {
+		if (!n--)
+			return 1;	/* slice used up, more to parse */
+#if MIDIIN_TIMESTAMPS
+		if (!parseByte(*c, rxTime[rxTail]))
+#else
+		if (!parseByte(*c, 0))
+#endif
+			break;		/* event queue full, wait for the host */
+		rxDrop();
+	}
+	return 0;
+}
+
+uchar midiInDepth(void)
+{
+	return rxCount();
+}
+
+uchar midiInEventDepth(void)
+{
+	return eventCount();
+}
+
+uchar midiInPacket(uchar * buf)
+{
+	uchar n = 0, *rt, glued = 0;
+	ringEvent_t *ev;
+
+	while (n < 8) {
+		if (!glued && (rt = rtPeek())) {
+			buf[n] = 0x0f;	/* CIN single byte */
+			buf[n + 1] = *rt;
+			buf[n + 2] = 0;
+			buf[n + 3] = 0;
+			stampEvent(rtTime[rtTail]);
+#if MIDIIN_STATS
+			{
+				unsigned lat = timebaseStamp() - rtTime[rtTail];
+
+				midiInStats.rtCount++;
+				if (lat < midiInStats.rtLatencyMin)
+					midiInStats.rtLatencyMin = lat;
+				if (lat > midiInStats.rtLatencyMax)
+					midiInStats.rtLatencyMax = lat;
+			}
+#endif
+			rtDrop();
+		} else if ((ev = eventPeek())) {
+			glued = eventGlue[eventTail];
+			if (glued && n)
+				break;	/* a pair starts the next packet */
+			memcpy(buf + n, ev->b, 4);
+			stampEvent(eventTime[eventTail]);
+			eventDrop();
+		} else {
+			break;
+		}
+		n += 4;
+	}
+	return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* USART receive complete                                                    */
+/*                                                                           */
+/* Level triggered until UDR0 is read: the stub masks RXCIE0 and enables     */
+/* interrupts for V-USB first, see usbsafe.h. The USART buffers a second     */
+/* byte while the body runs.                                                 */
+/*---------------------------------------------------------------------------*/
+
+USB_SAFE_BODY(rxInterrupt)
+{
+	uchar st, c, *p;
+
+	st = UCSR0A;
+	c = UDR0;
+	if (st & (1 << DOR0))
+		statsOverrun();
+	if (c >= 0xf8) {
+		if (filterSystem(FILTER_IN, c))
+			return 1;
+		if (!(p = rtSlot())) {
+			statsOverrun();
+			return 1;
+		}
+		*p = c;
+#if RT_STAMPS
+		rtTime[rtHead] = timebaseStamp();
+#endif
+		rtCommit();
+	} else {
+		if (!(p = rxSlot())) {
+			statsOverrun();
+			return 1;
+		}
+		*p = c;
+#if MIDIIN_TIMESTAMPS
+		rxTime[rxHead] = timebaseStamp();
+#endif
+		rxCommit();
+	}
+	return 1;
+}
+
+USB_SAFE_ISR_MASKED(USART_RX_vect, UCSR0B, RXCIE0, rxInterrupt)
@@ -0,0 +1,98 @@
+/* Name: midiin.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __midiin_h_included__
+#define __midiin_h_included__
+
+/*
+General Description:
+DIN MIDI input and the USB interrupt-in event queue. The USART receive
+interrupt stores bytes in a raw byte queue which the main loop parses into
+4 byte USB-MIDI event packets. Local events (keys) go into the same event
+queue. System realtime bytes (0xf8..0xff) skip both queues: the interrupt
+puts them in a separate lane of CIN 0xf events which midiInPacket() drains
+first, so a clock tick always takes the next free packet slot. The order of
+all other events is preserved. Pairs (14 bit controllers) always share a
+packet; a realtime event never splits them. Groups (one key on several
+zones) are queued whole and sent two to a packet in the same way.
+*/
+
+#include "midicomconfig.h"
+#include "timebase.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+#if MIDIIN_STATS
+/* Latencies are counted in device time (1/256 ms, see timebase.h) from the
+ * stop bit of a realtime byte to the hand-off of its packet to
+ * usbSetInterrupt(). max - min is the jitter added by the device; the host
+ * adds its own poll quantisation on top of that.
+ */
+typedef struct midiInStats {
+	unsigned rtCount;	/* realtime events sent */
+	unsigned rtLatencyMin;
+	unsigned rtLatencyMax;
+	uchar rxOverruns;	/* bytes lost in the USART or the byte queue */
+	uchar eventHighWater;	/* deepest event queue seen */
+} midiInStats_t;
+
+extern midiInStats_t midiInStats;
+void midiInStatsReset(void);
+#endif
+
+#if MIDIIN_TIMESTAMPS
+/* Every event is stamped (timebaseStamp()) when it is captured: DIN events
+ * at the stop bit of their first byte, local events when they are queued.
+ * With the side channel enabled, the stamps of the events handed to the
+ * interrupt-in endpoint are kept in send order until the host reads them
+ * with RQ_GET_TIMESTAMPS (see vendorrq.h), so host software can undo the
+ * poll interval quantisation. Each event sent counts one sequence number
+ * whether or not its stamp was read in time.
+ */
+extern uchar midiInStampsOn;
+void midiInStampsBegin(unsigned len);
+/* Starts a stamp read transfer of at most len bytes (wLength).
+ */
+uchar midiInStampsRead(uchar * data, uchar len);
+/* Supplies the next chunk of a stamp read, for usbFunctionRead().
+ */
+#endif
+
+void midiInInit(void);
+/* Enables the USART receiver interrupt. Call once after the baud rate is set.
+ */
+uchar midiInPoll(void);
+/* Parses up to MIDIIN_POLL_SLICE received DIN bytes into event packets while
+ * there is room for them. Returns non-zero if bytes are left for another
+ * slice. Call from the main loop.
+ */
+uchar midiInPut(uchar cin, uchar b1, uchar b2, uchar b3);
+/* Queues one event packet on cable 0. Returns 0 if the queue is full.
+ */
+uchar midiInPutPair(uchar cin, uchar b1, uchar b2, uchar b3, uchar c2,
+		    uchar c3);
+/* Queues two events with the same CIN and status byte b1, the second one
+ * with data bytes c2, c3, to be sent together in one interrupt-in packet.
+ * Returns 0 (and queues neither) if there is no room for both.
+ */
+uchar midiInPutGroup(uchar * events, uchar n, timestamp_t t);
+/* Queues n event packets of 4 bytes captured at stamp t, paired up so
+ * they take (n + 1) / 2 interrupt-in packets. Returns 0 (and queues none)
+ * if there is no room for all of them.
+ */
+uchar midiInDepth(void);
+/* Number of DIN bytes waiting to be parsed.
+ */
+uchar midiInEventDepth(void);
+/* Number of event packets waiting for the interrupt-in endpoint.
+ */
+uchar midiInPacket(uchar * buf);
+/* Fills buf with up to two event packets for the interrupt-in endpoint,
+ * realtime events first. Returns the number of bytes used (0, 4 or 8).
+ */
+
+#endif				/* __midiin_h_included__ */
@@ -0,0 +1,548 @@
+/* Name: midiout.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "midiout.h"
+#include "timebase.h"
+#include "usbsafe.h"
+#include "ring.h"
+#include "config.h"
+
+/* DIN bytes: main (or the compare interrupt while main is not inside
+ * a message, see txBusy) -> UDRE interrupt
+ */
+RING_BYTES(tx, MIDIOUT_QUEUE_SIZE)
+static volatile uchar rtSlot;	/* pending realtime byte, 0 = empty */
+static volatile uchar txBusy;	/* main is in the middle of a message */
+#if MIDIOUT_RUNNING_STATUS
+static uchar txRunning;		/* status of the last channel message, 0 = none */
+#endif
+
+#if MIDIOUT_THIN
+#if MIDIOUT_THIN_LEVEL >= MIDIOUT_QUEUE_SIZE - 1
+#error "midiout: MIDIOUT_THIN_LEVEL must be below the queue size"
+#endif
+
+/* Controller values still in the DIN queue that a newer value for the same
+ * channel and controller may overwrite. Only main uses the table.
+ */
+typedef struct thinEntry {
+	uchar status;		/* 0 = free */
+	uchar controller;	/* 0 for pitch bend and channel pressure */
+	unsigned seq;		/* txSeq of the first data byte */
+} thinEntry_t;
+
+static thinEntry_t thinTable[MIDIOUT_THIN];
+static uchar thinNext;		/* entry to check for staleness and reuse */
+static volatile uchar thinFlush;	/* bytes went in around the table */
+static unsigned txSeq;		/* bytes queued since the reset, mod 2^16 */
+#define seqCount()	txSeq++
+#else
+#define seqCount()
+#endif
+
+#if MIDIOUT_NOTES
+/* Notes on in any channel and the channels that had any since the last
+ * panic: a 128 bit map per channel would take a quarter of the RAM. A panic
+ * takes them over when it starts and works from its own copy, so notes
+ * sent meanwhile are tracked for the next one. Main and the compare
+ * interrupt both track notes as they go out; main does so only while
+ * txBusy or schedBusy keeps the interrupt away.
+ */
+static uchar noteOn[16];
+static unsigned noteChannels;
+static uchar panicNotes[16];
+static unsigned panicChannels;
+static uchar panicChannel = 16;	/* channel the panic is at, 16 = none */
+static uchar panicStep;		/* 0 sustain, 1 CC 123, 2.. notes */
+static uchar senseLeft;		/* polls to the sensing timeout */
+static uchar hostSynced;	/* frames were coming at the last poll */
+
+#define SENSE_TICKS	(300 / MIDIOUT_POLL_MS + 1)	/* MIDI 1.0: 300 ms */
+
+/* O(1) per event: a bit set or cleared, whatever is held. */
+static void noteTrack(uchar * ev)
+{
+	uchar cin = ev[0] & 0x0f, bit = 1 << (ev[2] & 7);
+	uchar *b = &noteOn[(ev[2] >> 3) & 15];
+
+	if (cin == 0x09 && ev[3]) {
+		*b |= bit;
+		noteChannels |= 1U << (ev[1] & 0x0f);
+	} else if (cin == 0x08 || cin == 0x09) {
+		*b &= ~bit;
+	}
+	if (senseLeft || ev[1] == 0xfe)	/* the host sends active sensing */
+		senseLeft = SENSE_TICKS;
+}
+#else
+#define noteTrack(ev)
+#endif
+
+#if MIDIOUT_SCHED_SIZE
+/* Scheduled events sorted by due time, [0] is next. Only main inserts and
+ * only the compare interrupt removes; it backs off while schedBusy is set.
+ */
+static timebase_t schedTime[MIDIOUT_SCHED_SIZE];
+static uchar schedEvent[MIDIOUT_SCHED_SIZE][4];
+static volatile uchar schedCount;
+static volatile uchar schedBusy;
+static uchar schedRecord[8];	/* partial record of a control write */
+static uchar schedFill;
+static uchar schedRemaining;	/* bytes left in the control write */
+
+#define SCHED_SPIN	32	/* 1/256 ms: closer than this, wait in the ISR */
+#define SCHED_SPIN_MAX	48	/* ticks: give up waiting if time stalls */
+#define SCHED_RETRY	4	/* ticks: try again when the queues were busy */
+#endif
+
+/* Number of MIDI bytes carried by each Code Index Number, see
+ * http://www.usb.org/developers/devclass_docs/midi10.pdf
+ * 4. USB MIDI Event Packets, Table 4-1.
+ */
+static PROGMEM const uchar cinLength[16] = {
+	0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1
+};
+
+/*---------------------------------------------------------------------------*/
+
+#if MIDIOUT_RUNNING_STATUS
+/* Index of the first byte of ev[1..n] to send: 2 if the status byte is
+ * the running status already.
+ */
+static uchar firstByte(uchar * ev, uchar n)
+{
+	return (n > 1 && ev[1] == txRunning) ? 2 : 1;
+}
+
+/* Follows the running status of the bytes queued: channel messages set it,
+ * system exclusive and common cancel it, realtime leaves it alone.
+ */
+static void setRunning(uchar c)
+{
+	if ((c & 0x80) && c < 0xf8)
+		txRunning = (c < 0xf0) ? c : 0;
+}
+#else
+#define firstByte(ev, n)	1
+#define setRunning(c)
+#endif
+
+static void txKick(void)
+{
+	uchar sreg = SREG;
+
+	/* UCSR0B is not bit addressable, keep the interrupt out of the RMW */
+	cli();
+	UCSR0B |= (1 << UDRIE0);
+	SREG = sreg;
+}
+
+void midiOutInit(void)
+{
+	txReset();
+	rtSlot = 0;
+#if MIDIOUT_THIN
+	txSeq = 0;		/* the ring index of byte seq is seq & mask */
+	thinFlush = 1;
+#endif
+	UCSR0B |= (1 << TXEN0);
+}
+
+static void putByte(uchar c)
+{
+	if (c >= 0xf8) {	/* realtime: may go between any two bytes */
+		while (rtSlot)	/* taken when UDR0 is free, one byte time */
+			;
+		rtSlot = c;
+	} else {
+		while (!txPut(c))	/* queue full, wait for the UART */
+			;
+		seqCount();
+	}
+	txKick();
+}
+
+#if MIDIOUT_THIN
+/* Channel messages that are a level, where only the last value matters:
+ * controllers, except data entry, (N)RPN selection and channel mode, pitch
+ * bend and channel pressure.
+ */
+static uchar thinnable(uchar cin, uchar cc)
+{
+	if (cin == 0x0b)
+		return cc != 6 && cc != 38 && (cc < 96 || cc > 101) && cc < 120;
+	return cin == 0x0d || cin == 0x0e;
+}
+
+static uchar thinLive(thinEntry_t * e)
+{
+	return (unsigned) (txSeq - e->seq) <= txCount();
+}
+
+/* Returns 1 if the congested queue still holds a value for the controller
+ * of packet and the new value was written over it: the packet is done.
+ * Otherwise notes where the packet's data bytes are about to go. Any other
+ * channel message frees the entries of its channel, and SysEx or system
+ * common frees them all, so a value never moves past a message that may
+ * depend on it (a note, a program change, another part of an RPN, a SysEx
+ * parameter change).
+ */
+static uchar thinPacket(uchar * ev, uchar n)
+{
+	thinEntry_t *e, *use = 0, *next;
+	uchar cin = ev[0] & 0x0f, s = ev[1], i, sreg, done = 0;
+
+	if (thinFlush) {
+		thinFlush = 0;
+		memset(thinTable, 0, sizeof(thinTable));
+	}
+	/* ages out one entry per packet, long before txSeq can come round */
+	next = &thinTable[thinNext];
+	if (++thinNext == MIDIOUT_THIN)
+		thinNext = 0;
+	if (next->status && !thinLive(next))
+		next->status = 0;
+	if (cin < 0x08 || cin == 0x0f) {
+		if (s < 0xf8)	/* SysEx and system common end all thinning */
+			memset(thinTable, 0, sizeof(thinTable));
+		return 0;
+	}
+	if (!thinnable(cin, ev[2])) {
+		for (e = thinTable; e < thinTable + MIDIOUT_THIN; e++)
+			if (!((e->status ^ s) & 0x0f))
+				e->status = 0;
+		return 0;
+	}
+	for (e = thinTable; e < thinTable + MIDIOUT_THIN; e++) {
+		if (!e->status) {
+			use = e;
+		} else if (e->status == s &&
+			   (cin != 0x0b || e->controller == ev[2])) {
+			use = e;
+			break;
+		}
+	}
+	if (use && use->status && txCount() >= MIDIOUT_THIN_LEVEL) {
+		sreg = SREG;
+		cli();		/* the UDRE interrupt must not take the bytes */
+		if (thinLive(use)) {
+			for (i = 2; i <= n; i++)
+				txBuf[(use->seq + i - 2) &
+				      (MIDIOUT_QUEUE_SIZE - 1)] = ev[i];
+			done = 1;
+		}
+		SREG = sreg;
+		if (done)
+			return 1;
+	}
+	if (!use)
+		use = next;
+	use->status = s;
+	use->controller = (cin == 0x0b) ? ev[2] : 0;
+	use->seq = txSeq + 2 - firstByte(ev, n);
+	return 0;
+}
+#else
+#define thinPacket(ev, n)	0
+#endif
+
+static void queuePacket(uchar * packet)
+{
+	uchar n, i;
+
+	n = pgm_read_byte(&cinLength[packet[0] & 0x0f]);
+	txBusy = 1;		/* keep scheduled events out of the message */
+	if (thinPacket(packet, n)) {
+		txBusy = 0;
+		return;
+	}
+	i = firstByte(packet, n);
+	setRunning(packet[1]);
+	for (; i <= n; i++)
+		putByte(packet[i]);
+	txBusy = 0;
+}
+
+void midiOutPacket(uchar * packet)
+{
+	txBusy = 1;		/* the compare interrupt tracks notes too */
+	noteTrack(packet);
+	queuePacket(packet);
+}
+
+uchar midiOutDepth(void)
+{
+	return txCount();
+}
+
+#if MIDIOUT_SCHED_SIZE
+/*---------------------------------------------------------------------------*/
+/* Scheduled output                                                          */
+/*---------------------------------------------------------------------------*/
+
+static void schedArmTicks(uchar ticks)
+{
+	uchar sreg = SREG;
+
+	cli();			/* a late write would miss the match by 256 ticks */
+	OCR0A = TCNT0 + ticks;
+	TIMSK0 |= (1 << OCIE0A);
+	SREG = sreg;
+}
+
+/* Arms Timer0 compare A a little before the next event is due, or at
+ * least once per frame while it is further away.
+ */
+static void schedArm(void)
+{
+	long diff;
+
+	if (!schedCount) {
+		TIMSK0 &= ~(1 << OCIE0A);
+		return;
+	}
+	diff = schedTime[0] - timebaseNow();
+	if (diff > 170 + SCHED_SPIN)
+		schedArmTicks(128);
+	else if (diff > SCHED_SPIN)	/* 1/256 ms to ticks, rounded short */
+		schedArmTicks((diff - SCHED_SPIN / 2) * 11 / 16);
+	else
+		schedArmTicks(2);	/* +1 could be passed before the write */
+}
+
+uchar midiOutScheduleFree(void)
+{
+	return MIDIOUT_SCHED_SIZE - schedCount;
+}
+
+static uchar schedInsert(uchar * rec)
+{
+	timebase_t t;
+	uchar i;
+
+	if (schedCount == MIDIOUT_SCHED_SIZE)
+		return 0;
+	if (!filterPacket(FILTER_OUT, rec + 4))
+		return 1;	/* dropped by the rules, taken all the same */
+	memcpy(&t, rec, 4);	/* little endian, like the AVR */
+	schedBusy = 1;
+	for (i = schedCount; i > 0 && (long) (schedTime[i - 1] - t) > 0; i--) {
+		schedTime[i] = schedTime[i - 1];
+		memcpy(schedEvent[i], schedEvent[i - 1], 4);
+	}
+	schedTime[i] = t;
+	memcpy(schedEvent[i], rec + 4, 4);
+	schedCount++;
+	schedBusy = 0;
+	schedArm();
+	return 1;
+}
+
+#define SCHED_REJECT	0xff	/* schedFill: stall the whole transfer */
+
+void midiOutScheduleBegin(unsigned len)
+{
+	schedFill = 0;
+	schedRemaining = len;
+	/* all or nothing, so a retried request never plays records twice */
+	if (len > 255 || (len & 7) || len / 8 > midiOutScheduleFree())
+		schedFill = SCHED_REJECT;
+}
+
+uchar midiOutScheduleWrite(uchar * data, uchar len)
+{
+	if (schedFill == SCHED_REJECT)
+		return 0xff;
+	if (len > schedRemaining)
+		len = schedRemaining;
+	schedRemaining -= len;
+	while (len--) {
+		schedRecord[schedFill++] = *data++;
+		if (schedFill == 8) {
+			schedFill = 0;
+			if (!schedInsert(schedRecord))
+				return 0xff;	/* checked in Begin(), cannot happen */
+		}
+	}
+	return schedRemaining == 0;
+}
+
+/* Moves the head event to the DIN queue if there is room right now.
+ */
+static uchar schedRelease(void)
+{
+	uchar *ev = schedEvent[0];
+	uchar n, i;
+
+	n = pgm_read_byte(&cinLength[ev[0] & 0x0f]);
+	if (n == 1 && ev[1] >= 0xf8) {
+		if (rtSlot)
+			return 0;
+		rtSlot = ev[1];
+	} else {
+		i = firstByte(ev, n);
+		if (txSpace() < n + 1 - i)
+			return 0;
+		setRunning(ev[1]);
+		for (; i <= n; i++) {
+			txPut(ev[i]);
+			seqCount();
+		}
+#if MIDIOUT_THIN
+		thinFlush = 1;
+#endif
+	}
+	noteTrack(ev);		/* when it goes out: a panic drops the rest */
+	txKick();
+	n = --schedCount;
+	for (i = 0; i < n; i++) {
+		schedTime[i] = schedTime[i + 1];
+		memcpy(schedEvent[i], schedEvent[i + 1], 4);
+	}
+	return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Timer0 compare A                                                          */
+/*                                                                           */
+/* The flag clears on entry, so interrupts are enabled right away. The last  */
+/* SCHED_SPIN before an event are waited out here for an exact release.      */
+/*---------------------------------------------------------------------------*/
+
+USB_SAFE_ISR(TIMER0_COMPA_vect)
+{
+	long diff;
+	uchar start;
+
+	if (txBusy || schedBusy) {
+		schedArmTicks(SCHED_RETRY);
+		return;
+	}
+	while (schedCount) {
+		diff = schedTime[0] - timebaseNow();
+		if (diff > SCHED_SPIN)
+			break;
+		start = TCNT0;	/* time stands still between late frames */
+		while (diff > 0 && (uchar) (TCNT0 - start) < SCHED_SPIN_MAX)
+			diff = schedTime[0] - timebaseNow();
+		if (!schedRelease()) {
+			schedArmTicks(SCHED_RETRY);
+			return;
+		}
+	}
+	schedArm();
+}
+#endif
+
+#if MIDIOUT_NOTES
+/*---------------------------------------------------------------------------*/
+/* Held notes                                                                */
+/*---------------------------------------------------------------------------*/
+
+void midiOutPanic(void)
+{
+	uchar i;
+
+#if MIDIOUT_SCHED_SIZE
+	schedBusy = 1;		/* whoever sent them is gone */
+	schedCount = 0;
+#endif
+	for (i = 0; i < 16; i++) {	/* adds to a panic under way */
+		panicNotes[i] |= noteOn[i];
+		noteOn[i] = 0;
+	}
+	panicChannels |= noteChannels;
+	noteChannels = 0;
+	panicChannel = 0;
+	panicStep = 0;
+	senseLeft = 0;
+#if MIDIOUT_SCHED_SIZE
+	schedBusy = 0;
+	schedArm();
+#endif
+}
+
+uchar midiOutPoll(void)
+{
+	uchar packet[4], synced = timebaseSynced(), n, sreg, silent;
+
+	if (hostSynced && !synced)	/* suspend or a pulled cable */
+		midiOutPanic();
+	hostSynced = synced;
+	sreg = SREG;
+	cli();			/* a scheduled 0xfe may reload it */
+	silent = senseLeft && !--senseLeft;
+	SREG = sreg;
+	if (silent)
+		midiOutPanic();
+	while (panicChannel < 16 && txSpace() >= 3) {
+		if (panicStep == 130 ||
+		    !(panicChannels & (1U << panicChannel))) {
+			panicStep = 0;
+			if (++panicChannel == 16) {
+				panicChannels = 0;
+				memset(panicNotes, 0, sizeof(panicNotes));
+			}
+			continue;
+		}
+		n = panicStep++;
+		packet[0] = 0x0b;
+		packet[1] = 0xb0 | panicChannel;
+		packet[3] = 0;
+		if (n < 2) {
+			packet[2] = n ? 123 : 64;
+		} else {
+			n -= 2;
+			if (!(n & 7) && !panicNotes[n >> 3]) {
+				panicStep += 7;
+				continue;
+			}
+			if (!(panicNotes[n >> 3] & (1 << (n & 7))))
+				continue;
+			packet[0] = 0x08;
+			packet[1] = 0x80 | panicChannel;
+			packet[2] = n;
+		}
+		queuePacket(packet);
+	}
+	return 0;
+}
+#else
+void midiOutPanic(void)
+{
+}
+#endif
+
+/*---------------------------------------------------------------------------*/
+/* USART data register empty                                                 */
+/*                                                                           */
+/* The flag stays set until UDR0 is written, so the stub masks UDRIE0 before */
+/* enabling interrupts for V-USB (see usbsafe.h). When idle the body leaves  */
+/* it masked until the next kick.                                            */
+/*---------------------------------------------------------------------------*/
+
+USB_SAFE_BODY(udreInterrupt)
+{
+	uchar c, *p;
+
+	c = rtSlot;
+	if (c) {
+		rtSlot = 0;
+	} else {
+		if (!(p = txPeek()))
+			return 0;	/* idle */
+		c = *p;
+		txDrop();
+	}
+	UDR0 = c;
+	return 1;		/* unmasked even if empty: one spare call */
+}
+
+USB_SAFE_ISR_MASKED(USART_UDRE_vect, UCSR0B, UDRIE0, udreInterrupt)
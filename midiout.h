@@ -0,0 +1,102 @@
+/* Name: midiout.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __midiout_h_included__
+#define __midiout_h_included__
+
+/*
+General Description:
+DIN MIDI output. USB-MIDI event packets from the host are decoded into raw
+MIDI bytes and queued for the USART, which is fed from the UDRE interrupt.
+System realtime bytes (0xf8..0xff) bypass the queue through a single-byte
+slot that the interrupt always serves first, so a clock tick never waits for
+more than the two bytes the USART already holds, the one in its shift
+register and the one in UDR0 (640 us at 31.25 kbaud), however much SysEx
+is queued in front of it.
+
+Scheduled output: the host sends events ahead of time with a target device
+time (see timebase.h and RQ_SCHEDULE_OUT in vendorrq.h). They wait in a
+small time-ordered queue and the Timer0 compare interrupt moves each one to
+the DIN queue at its due time, so their spacing comes from the device clock
+instead of the USB poll interval. A scheduled event never splits a message
+that main is queueing.
+
+With MIDIOUT_RUNNING_STATUS the status byte of a channel message is left
+out when it repeats the previous one, which saves a third of the wire time
+for controller streams.
+
+Congestion: a host can send controllers far faster than 31.25 kbaud
+carries them, and a plain queue then plays a sweep back seconds late.
+With MIDIOUT_THIN, once MIDIOUT_THIN_LEVEL bytes are waiting, a new value
+for a controller, pitch bend or channel pressure that still has a value in
+the queue overwrites that value in place instead of queueing behind it.
+Notes, program changes, SysEx and the data entry controllers are never
+dropped. Any of them on a channel ends the thinning of the values queued
+before it on that channel, and SysEx or system common ends it on all
+channels, so the order that matters is kept. The table takes 4 bytes per
+controller; by default it is on when the RAM plan has room.
+
+Held notes: with MIDIOUT_NOTES every note on and off sent to DIN sets or
+clears a bit in a map of sounding notes (a scheduled one when it is
+released, not when it arrives), so a synth is not left with hung notes
+when the host goes away. midiOutPanic() runs on a USB bus reset
+(USB_RESET_HOOK in usbconfig.h), midiOutPoll() when the frames stop
+(suspend, or a pulled cable on a self-powered device) and when a host that
+sent active sensing falls silent for 300 ms. It drops the schedule and
+sends sustain off, all notes off (CC 123) and a note off for each note in
+the map on each channel that had notes, a few bytes per poll so the main
+loop never waits. The panic takes the map over when it starts and the
+tracking starts afresh, so notes sent while it runs get their own note
+offs if another panic follows. The map is shared by all channels, so a
+channel may get note offs for notes it never played; they do no harm. The
+maps take 41 bytes; by default they are there when the RAM plan has room.
+*/
+
+#include "midicomconfig.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+void midiOutInit(void);
+/* Enables the USART transmitter. Call once after the baud rate is set.
+ */
+void midiOutPacket(uchar * packet);
+/* Decodes one 4 byte USB-MIDI event packet and queues its MIDI bytes. Waits
+ * (for at most a few byte times) if the queue or the realtime slot is full.
+ */
+uchar midiOutDepth(void);
+/* Number of bytes waiting in the DIN queue.
+ */
+void midiOutPanic(void);
+/* Silences every note sent since the last panic, see above. Does nothing
+ * without MIDIOUT_NOTES.
+ */
+#if MIDIOUT_NOTES
+#define MIDIOUT_POLL_MS	10
+
+uchar midiOutPoll(void);
+/* Watches the host and sends a pending panic while the DIN queue has room.
+ * Returns 0. Call every MIDIOUT_POLL_MS.
+ */
+#endif
+
+#if MIDIOUT_SCHED_SIZE
+void midiOutScheduleBegin(unsigned len);
+/* Starts a control write of len bytes of 8 byte records: due time (4 bytes,
+ * timebase_t little endian) followed by a USB-MIDI event packet. The write
+ * is refused if len is over 255 bytes, not a multiple of 8 or more records
+ * than the schedule has room for.
+ */
+uchar midiOutScheduleWrite(uchar * data, uchar len);
+/* Takes the next chunk of the control write, for usbFunctionWrite(). Returns
+ * 1 after the last chunk and 0xff (stall) if the write was refused.
+ */
+uchar midiOutScheduleFree(void);
+/* Number of free schedule slots.
+ */
+#endif
+
+#endif				/* __midiout_h_included__ */
@@ -0,0 +1,219 @@
+/* Name: power.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+#include "usbdrv.h"
+#include "power.h"
+#include "timebase.h"
+#include "midiin.h"
+#include "midiout.h"
+#include "keys.h"
+#include "usbsafe.h"
+
+#if POWER_SLEEP
+
+/* power-down needs every input to have a pin change to wake on */
+#define POWER_DOWN	(KEYS_WAKE && !ANALOG_COUNT && !TRAVEL_KEYS)
+
+#define RESUME_TICKS	(10 * TIMEBASE_FRAME_TICKS)	/* K state, 1..15 ms */
+#define RESUME_IDLE	(2 * 256)	/* 1/256 ms: idle 5 ms before resume */
+
+#define RQ_FEATURE_REMOTE_WAKEUP	1	/* wValue of SET_FEATURE */
+
+#if !USB_CFG_HAVE_FLOWCONTROL
+extern volatile schar usbRxLen;	/* message waiting for usbPoll() */
+#endif
+
+powerStats_t powerStats;
+static uchar remoteWakeOn;	/* host enabled remote wakeup */
+static uchar suspended;
+static uchar wakeSent;		/* once per suspend */
+static timebase_t suspendTime;
+static timestamp_t lastIdle;
+
+#define saturate(c)	do { if ((c) != 0xff) (c)++; } while (0)
+
+void powerStatsReset(void)
+{
+	powerStats.asleep = 0;
+	powerStats.total = 0;
+	powerStats.suspends = 0;
+	powerStats.powerDowns = 0;
+	powerStats.wakeups = 0;
+}
+
+void powerInit(void)
+{
+	TIMSK0 |= (1 << OCIE0B);
+	lastIdle = timebaseStamp();
+}
+
+void powerRxHook(uchar * data)
+{
+	if (usbRxToken != (uchar) USBPID_SETUP || data[0] != 0)
+		return;		/* standard device requests only */
+	if (data[1] == USBRQ_SET_ADDRESS)	/* after a bus reset: off */
+		remoteWakeOn = 0;
+	else if (data[2] == RQ_FEATURE_REMOTE_WAKEUP &&
+		 (data[1] == USBRQ_SET_FEATURE ||
+		  data[1] == USBRQ_CLEAR_FEATURE))
+		remoteWakeOn = (data[1] == USBRQ_SET_FEATURE);
+}
+
+/* Drives K for RESUME_TICKS with the USB interrupt masked, so the driver
+ * does not take our own signalling for a packet. Global interrupts stay on
+ * for the other handlers; the port updates are locked because the ADC
+ * interrupt moves the 4051 select lines on PORTD.
+ */
+static void remoteWakeup(void)
+{
+	unsigned wait = RESUME_TICKS;
+	uchar tick, last, delta, sreg;
+
+	USB_INTR_ENABLE &= ~(1 << USB_INTR_ENABLE_BIT);
+	sreg = SREG;
+	cli();
+	USBOUT = (USBOUT & ~USBMASK) | (1 << USB_CFG_DPLUS_BIT);
+	USBDDR |= USBMASK;
+	SREG = sreg;
+	last = TCNT0;
+	while (wait) {
+		tick = TCNT0;
+		delta = tick - last;
+		last = tick;
+		wait = (delta < wait) ? wait - delta : 0;
+		timebasePoll();
+	}
+	sreg = SREG;
+	cli();
+	USBDDR &= ~USBMASK;
+	USBOUT &= ~USBMASK;
+	SREG = sreg;
+	USB_INTR_PENDING = (1 << USB_INTR_PENDING_BIT);
+	USB_INTR_ENABLE |= (1 << USB_INTR_ENABLE_BIT);
+}
+
+static void sleepIdle(void)
+{
+	timestamp_t start;
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	start = timebaseStamp();	/* has a multiply: keep it out of cli */
+	cli();
+	if (usbRxLen > 0 || midiInDepth()) {	/* came after the tasks */
+		sei();
+		return;
+	}
+	OCR0B = TCNT0 + TIMEBASE_FRAME_TICKS;	/* wake within a frame */
+	sleep_enable();
+	sei();
+	sleep_cpu();		/* runs before any interrupt pending at sei */
+	sleep_disable();
+	powerStats.asleep += (timestamp_t) (timebaseStamp() - start);
+}
+
+#if POWER_DOWN
+/* The watchdog cannot be served while powered down and is switched off;
+ * bus activity wakes through the pin change interrupt of D-, which is on
+ * PORTD with the encoder (see encoder.c).
+ */
+static void sleepDown(void)
+{
+	wdt_disable();
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	cli();			/* PCINT0 writes PCICR too */
+	PCMSK2 |= (1 << USB_CFG_DMINUS_BIT);
+	PCIFR = (1 << PCIF2);
+	PCICR |= (1 << PCIE2);
+	if (keysQuiet() && (USBIN & (1 << USB_CFG_DMINUS_BIT))) {	/* J */
+		saturate(powerStats.powerDowns);
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		cli();
+	}
+	PCMSK2 &= ~(1 << USB_CFG_DMINUS_BIT);
+#if !ENC_COUNT
+	PCICR &= ~(1 << PCIE2);
+#endif
+	sei();
+	wdt_enable(WDTO_1S);
+	WDTCSR |= (1 << WDIE);	/* interrupt first, see crashlogInit() */
+}
+
+#if !ENC_COUNT
+USB_SAFE_ISR(PCINT2_vect)
+{
+}
+#endif
+#endif				/* POWER_DOWN */
+
+void powerIdle(void)
+{
+	timestamp_t now = timebaseStamp();
+
+	powerStats.total += (timestamp_t) (now - lastIdle);
+	lastIdle = now;
+	if (!usbConfiguration || timebaseSynced()) {
+		suspended = 0;
+	} else if (!suspended) {	/* 3 ms without frames */
+		suspended = 1;
+		wakeSent = 0;
+		suspendTime = timebaseNow();
+		saturate(powerStats.suspends);
+	}
+	if (!suspended) {
+		sleepIdle();
+		return;
+	}
+	if (midiInEventDepth()) {
+		if (remoteWakeOn && !wakeSent &&
+		    timebaseNow() - suspendTime >= RESUME_IDLE) {
+			remoteWakeup();
+			wakeSent = 1;
+			saturate(powerStats.wakeups);
+			return;
+		}
+	}
+#if POWER_DOWN
+	else if (keysQuiet() && !midiOutDepth()) {
+		sleepDown();
+		return;
+	}
+#endif
+	sleepIdle();
+}
+
+/*---------------------------------------------------------------------------*/
+/* Timer0 compare B                                                          */
+/*                                                                           */
+/* Nothing to do: it only ends idle sleep a frame after it started, well     */
+/* within the Timer0 wrap that timebasePoll() must not miss.                 */
+/*---------------------------------------------------------------------------*/
+
+USB_SAFE_ISR(TIMER0_COMPB_vect)
+{
+}
+
+#else				/* POWER_SLEEP */
+
+void powerInit(void)
+{
+}
+
+void powerIdle(void)
+{
+}
+
+void powerRxHook(uchar * data)
+{
+}
+
+#endif				/* POWER_SLEEP */
@@ -0,0 +1,64 @@
+/* Name: power.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __power_h_included__
+#define __power_h_included__
+
+/*
+General Description:
+Sleep between events and USB suspend. When a pass of the main loop leaves
+no task with work pending (see tasks.h), powerIdle() puts the CPU into
+idle sleep until the next interrupt: USB (at least the 1 ms keep-alive),
+USART, ADC, pin change or Timer0 compare B, which is set a frame ahead so
+that keys are scanned and the free-running time (see timebase.h) is
+polled without host frames too.
+
+No frames for 3 ms (timebaseSynced() turns 0) after the device was
+configured means the host suspended the bus. With KEYS_WAKE and no ADC
+inputs, the device then goes to power-down with the watchdog off, woken by
+bus activity on D- (resume or reset) or a pin change of the keys;
+otherwise it keeps idling and scanning. A key event queued while suspended
+signals remote wakeup (10 ms of K state) if the host enabled that feature.
+Device time stands still while powered down, as Timer0 stops.
+
+powerStats counts device time asleep in idle against the total, which is
+the CPU duty cycle: current is roughly idle current plus that fraction of
+the active current. Read it with RQ_GET_POWER_STATS (see vendorrq.h).
+*/
+
+#include "midicomconfig.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+#if POWER_SLEEP
+typedef struct powerStats {
+	unsigned long asleep;	/* 1/256 ms in idle sleep */
+	unsigned long total;	/* 1/256 ms counted, asleep or not */
+	uchar suspends;		/* bus suspends seen, saturates */
+	uchar powerDowns;	/* power-down sleeps, saturates */
+	uchar wakeups;		/* remote wakeups signalled, saturates */
+} powerStats_t;
+
+extern powerStats_t powerStats;
+
+void powerStatsReset(void);
+#endif
+
+void powerInit(void);
+/* Enables the Timer0 compare B interrupt as a wakeup source.
+ */
+void powerIdle(void);
+/* Sleeps until the next interrupt, tracks bus suspend and signals remote
+ * wakeup. Call from the main loop when no work is pending.
+ */
+void powerRxHook(uchar * data);
+/* Follows SET_FEATURE and CLEAR_FEATURE of DEVICE_REMOTE_WAKEUP, which the
+ * driver accepts without telling us. Called for every received message
+ * through USB_RX_USER_HOOK in usbconfig.h.
+ */
+
+#endif				/* __power_h_included__ */
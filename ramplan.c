@@ -0,0 +1,39 @@
+/* Name: ramplan.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <avr/io.h>
+
+#include "ramplan.h"
+
+typedef char ramPlanCheck[RAM_PLANNED + RAM_STACK_RESERVE <= RAM_SIZE ? 1 : -1];
+
+#define STACK_PAINT	0xc5
+
+extern uchar _end;		/* end of .noinit, from the linker script */
+
+ramInfo_t ramInfo;
+
+/* Runs from .init3, after the stack pointer is set up and before the data
+ * is copied, with nothing on the stack yet.
+ */
+void ramPaint(void) __attribute__ ((naked, used, section(".init3")));
+void ramPaint(void)
+{
+	uchar *p = &_end;
+
+	while (p <= (uchar *) SP)
+		*p++ = STACK_PAINT;
+}
+
+void ramInfoUpdate(void)
+{
+	uchar *p = &_end;
+
+	while (p <= (uchar *) RAMEND && *p == STACK_PAINT)
+		p++;
+	ramInfo.stackFree = p - &_end;
+	ramInfo.dataSize = &_end - (uchar *) RAMSTART;
+	ramInfo.planned = RAM_PLANNED;
+}
@@ -0,0 +1,35 @@
+/* Name: ramplan.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __ramplan_h_included__
+#define __ramplan_h_included__
+
+/*
+General Description:
+Build-time check of the RAM plan in midicomconfig.h, and stack painting to
+see how much of the stack reserve is really used. Before main() the free
+RAM between the end of the data and the stack is filled with a pattern;
+ramInfoUpdate() counts how much of it is still intact.
+*/
+
+#include "midicomconfig.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+typedef struct ramInfo {	/* RQ_GET_RAM_INFO reply */
+	unsigned stackFree;	/* painted bytes never touched by the stack */
+	unsigned dataSize;	/* .data + .bss + .noinit as linked */
+	unsigned planned;	/* RAM_PLANNED */
+} ramInfo_t;
+
+extern ramInfo_t ramInfo;
+
+void ramInfoUpdate(void);
+/* Fills in ramInfo. Scans the painted area, up to a few hundred bytes.
+ */
+
+#endif				/* __ramplan_h_included__ */
@@ -0,0 +1,108 @@
+/* Name: ring.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __ring_h_included__
+#define __ring_h_included__
+
+/*
+General Description:
+Single-producer/single-consumer rings between interrupts and main. Sizes
+are powers of two up to 256 and the indices are single bytes, so every
+index update is one store and neither side needs cli(). The producer only
+writes name##Head and the consumer only writes name##Tail; a ring holds
+size - 1 elements.
+
+RING_DEFINE(name, type, size) defines the buffer and static inline access
+functions in the including file:
+
+	producer:	name##Slot()	free element or 0 if full
+			name##Commit()	publishes the element from Slot()
+			name##Put(v)	copies v in, 0 if full
+	consumer:	name##Peek()	oldest element or 0 if empty
+			name##Drop()	releases the element from Peek()
+	either:		name##Count(), name##Space(), name##Reset()
+
+Slot()/Commit() and Peek()/Drop() let the caller fill or read in place.
+Parallel arrays (time stamps) are indexed with name##Head between Slot()
+and Commit() and with name##Tail between Peek() and Drop(). name##High
+keeps the highest Count() seen after a Commit(); the producer updates it.
+*/
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+typedef struct ringEvent {	/* one USB-MIDI event packet */
+	uchar b[4];
+} ringEvent_t;
+
+/* element accesses must not move past the index update */
+#define RING_BARRIER()	asm volatile ("" ::: "memory")
+
+#define RING_BYTES(name, size)	RING_DEFINE(name, uchar, size)
+#define RING_EVENTS(name, size)	RING_DEFINE(name, ringEvent_t, size)
+
+#define RING_DEFINE(name, type, size) \
+typedef char name##SizeCheck[((size) & ((size) - 1)) || (size) > 256 ? -1 : 1]; \
+static type name##Buf[size]; \
+static volatile uchar name##Head; \
+static volatile uchar name##Tail; \
+static uchar name##High; \
+\
+static inline uchar name##Count(void) \
+{ \
+	return (uchar) (name##Head - name##Tail) & ((size) - 1); \
+} \
+static inline uchar name##Space(void) \
+{ \
+	return (uchar) (name##Tail - name##Head - 1) & ((size) - 1); \
+} \
+static inline void name##Reset(void) \
+{ \
+	name##Head = name##Tail = name##High = 0; \
+} \
+static inline type *name##Slot(void) \
+{ \
+	uchar head = name##Head; \
+\
+	if (((head + 1) & ((size) - 1)) == name##Tail) \
+		return 0; \
+	return &name##Buf[head]; \
+} \
+static inline void name##Commit(void) \
+{ \
+	uchar n; \
+\
+	RING_BARRIER(); \
+	name##Head = (name##Head + 1) & ((size) - 1); \
+	n = name##Count(); \
+	if (n > name##High) \
+		name##High = n; \
+} \
+static inline uchar name##Put(type v) \
+{ \
+	type *p = name##Slot(); \
+\
+	if (!p) \
+		return 0; \
+	*p = v; \
+	name##Commit(); \
+	return 1; \
+} \
+static inline type *name##Peek(void) \
+{ \
+	uchar tail = name##Tail; \
+\
+	if (tail == name##Head) \
+		return 0; \
+	return &name##Buf[tail]; \
+} \
+static inline void name##Drop(void) \
+{ \
+	RING_BARRIER(); \
+	name##Tail = (name##Tail + 1) & ((size) - 1); \
+}
+
+#endif				/* __ring_h_included__ */
@@ -0,0 +1,84 @@
+/* Name: tasks.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+
+#include "usbdrv.h"
+#include "tasks.h"
+#include "crashlog.h"
+#include "power.h"
+
+taskStats_t taskStats[TASK_MAX];
+uchar taskCount;
+static timestamp_t taskDue[TASK_MAX];
+static uchar taskMore;		/* bit per task: slice pending */
+
+void taskStatsReset(void)
+{
+	memset(taskStats, 0, sizeof(taskStats));
+}
+
+static void taskRun(const task_t * t, uchar i)
+{
+	uchar (*run)(void);
+	timestamp_t start;
+	unsigned used;
+
+	crashlogPhase(pgm_read_byte(&t->phase));
+	run = (uchar (*)(void)) pgm_read_word(&t->run);
+	start = timebaseStamp();
+	if (run())
+		taskMore |= 1 << i;
+	else
+		taskMore &= ~(1 << i);
+	used = timebaseStamp() - start;
+	if (used > 0xff)
+		used = 0xff;
+	if (used > taskStats[i].worst)
+		taskStats[i].worst = used;
+	if (used > pgm_read_byte(&t->budget) && taskStats[i].overruns != 0xff)
+		taskStats[i].overruns++;
+	taskDue[i] = start + pgm_read_word(&t->period);
+}
+
+void taskLoop(const task_t * table, uchar count)
+{
+	timestamp_t now;
+	uchar i, best, prio, p, ready;
+
+	taskCount = count;
+	for (;;) {
+		wdt_reset();
+		now = timebaseStamp();
+		ready = taskMore;
+		for (i = 0; i < count; i++)
+			if ((int) (now - taskDue[i]) >= 0)
+				ready |= 1 << i;
+		while (ready) {
+			crashlogPhase(CRASH_PHASE_USB);
+			usbPoll();	/* hard priority: before every task */
+			best = 0;
+			prio = 0;
+			for (i = 0; i < count; i++) {
+				if (!(ready & (1 << i)))
+					continue;
+				p = pgm_read_byte(&table[i].priority);
+				if (!(ready & (1 << best)) || p > prio) {
+					best = i;
+					prio = p;
+				}
+			}
+			ready &= ~(1 << best);
+			taskRun(&table[best], best);
+		}
+		crashlogPhase(CRASH_PHASE_USB);
+		usbPoll();
+		if (!taskMore)
+			powerIdle();	/* until the next interrupt */
+	}
+}
@@ -0,0 +1,67 @@
+/* Name: tasks.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __tasks_h_included__
+#define __tasks_h_included__
+
+/*
+General Description:
+Cooperative main loop. The application lists its jobs in a static table in
+flash. Each pass of the loop marks the tasks whose period has elapsed and
+runs them one at a time, highest priority first, with usbPoll() before
+every task, so the time between two usbPoll() calls is bounded by the
+longest single task rather than by the whole loop.
+
+A task returns non-zero if it stopped early with work left (a slice); it
+then runs again in the next pass regardless of its period. Long jobs keep
+their own position between slices.
+
+A pass that leaves no slice pending ends in powerIdle() (see power.h),
+which sleeps until the next interrupt.
+
+The time each run takes is measured in device time and compared against the
+task's budget. Overruns are counted per task and reported with
+RQ_GET_TASK_STATS (see vendorrq.h).
+*/
+
+#include "midicomconfig.h"
+#include "timebase.h"
+
+#if TASK_MAX > 8
+#error "TASK_MAX: the pending and ready masks are one byte"
+#endif
+
+typedef struct task {
+	uchar (*run)(void);	/* non-zero: slice done, work left */
+	unsigned period;	/* 1/256 ms between runs, 0 = every pass */
+	uchar budget;		/* 1/256 ms (47 cycles at 12 MHz) per run */
+	uchar priority;		/* higher runs first */
+	uchar phase;		/* crashPhase while running, see crashlog.h */
+} task_t;
+
+#define TASK_MS(ms)	((unsigned) ((ms) * 256))
+#define TASK_US(us)	((uchar) ((us) * 256L / 1000))
+
+/* Put after the table: fails to compile if it has more than TASK_MAX
+ * entries for taskStats[] and the masks.
+ */
+#define TASK_TABLE_CHECK(table) \
+	typedef char table##Check[sizeof(table) / sizeof(table[0]) <= \
+				  TASK_MAX ? 1 : -1]
+
+typedef struct taskStats {
+	uchar overruns;		/* runs over budget, saturates */
+	uchar worst;		/* longest run, 1/256 ms, saturates */
+} taskStats_t;
+
+extern taskStats_t taskStats[TASK_MAX];
+extern uchar taskCount;
+
+void taskLoop(const task_t * table, uchar count);
+/* Runs the table (in PROGMEM) forever, resetting the watchdog once per pass.
+ */
+void taskStatsReset(void);
+
+#endif				/* __tasks_h_included__ */
@@ -0,0 +1,24 @@
+/* Name: eeprom.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __avr_eeprom_h_included__
+#define __avr_eeprom_h_included__
+
+/* Host stand-in: EEMEM data is ordinary RAM and stub.c counts the cells
+ * each update actually changes, as the real EEPROM would wear them.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM
+
+extern unsigned long eepromWrites;
+
+uint8_t eeprom_read_byte(const uint8_t * p);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_update_byte(uint8_t * p, uint8_t v);
+int eeprom_is_ready(void);
+
+#endif				/* __avr_eeprom_h_included__ */
@@ -0,0 +1,16 @@
+/* Name: interrupt.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __avr_interrupt_h_included__
+#define __avr_interrupt_h_included__
+
+/* Host stand-in: handlers are plain functions the tests call. */
+#define ISR(vect, ...)	void vect(void); void vect(void)
+#define ISR_NOBLOCK
+#define ISR_NAKED
+#define sei()
+#define cli()
+
+#endif				/* __avr_interrupt_h_included__ */
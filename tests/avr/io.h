@@ -0,0 +1,49 @@
+/* Name: io.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __avr_io_h_included__
+#define __avr_io_h_included__
+
+/*
+General Description:
+Host stand-in for the avr-libc header: the ATmega168 registers the tested
+files touch, as plain variables defined in stub.c, and their bit numbers.
+*/
+
+#include <stdint.h>
+
+#ifndef AVR_REG
+#define AVR_REG(type, name)	extern volatile type name;
+#endif
+
+AVR_REG(uint8_t, PORTB) AVR_REG(uint8_t, PINB) AVR_REG(uint8_t, DDRB)
+AVR_REG(uint8_t, PORTC) AVR_REG(uint8_t, PINC) AVR_REG(uint8_t, DDRC)
+AVR_REG(uint8_t, PORTD) AVR_REG(uint8_t, PIND) AVR_REG(uint8_t, DDRD)
+AVR_REG(uint8_t, UCSR0A) AVR_REG(uint8_t, UCSR0B) AVR_REG(uint8_t, UDR0)
+AVR_REG(uint8_t, TCNT0) AVR_REG(uint8_t, OCR0A) AVR_REG(uint8_t, TIMSK0)
+AVR_REG(uint8_t, TIFR0)
+AVR_REG(uint8_t, ADMUX) AVR_REG(uint8_t, ADCSRA) AVR_REG(uint8_t, ADCH)
+AVR_REG(uint8_t, DIDR0)
+AVR_REG(uint8_t, SREG)
+
+#define RAMSTART	0x100
+#define RAMEND		0x4ff
+#define E2END		0x1ff
+
+#define PD5	5
+#define RXCIE0	7
+#define UDRIE0	5
+#define RXEN0	4
+#define TXEN0	3
+#define DOR0	3
+#define OCIE0A	1
+#define OCF0A	1
+#define REFS0	6
+#define ADLAR	5
+#define ADEN	7
+#define ADSC	6
+#define ADIE	3
+
+#endif				/* __avr_io_h_included__ */
@@ -0,0 +1,16 @@
+/* Name: pgmspace.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __avr_pgmspace_h_included__
+#define __avr_pgmspace_h_included__
+
+/* Host stand-in: flash tables are ordinary constants. */
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(p)	(*(const uint8_t *) (p))
+#define pgm_read_word(p)	(*(const uint16_t *) (p))
+
+#endif				/* __avr_pgmspace_h_included__ */
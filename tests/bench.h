@@ -0,0 +1,30 @@
+/* Name: bench.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __bench_h_included__
+#define __bench_h_included__
+
+/*
+General Description:
+Host timing loops for the hot paths, run with "make bench". Each one
+calls the code under test the way the firmware does, a few million
+times, and prints the mean time per call. The host is not the AVR: the
+figures compare two versions of the code on the same machine, they are
+not cycle counts on the target. A simulator run on the real build would
+give those; the loops are written so they port to one unchanged.
+*/
+
+#include "test.h"
+
+extern volatile unsigned long benchSink;	/* keeps results alive */
+
+double benchNow(void);
+/* Monotonic time in nanoseconds.
+ */
+void benchReport(const char *what, double start, unsigned long calls);
+/* Prints the mean time per call since start.
+ */
+
+#endif				/* __bench_h_included__ */
@@ -0,0 +1,68 @@
+/* Name: bench_filter.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+/* Per message cost of filterPacket(): the default rules, and a table that
+ * blocks, splits, transposes and remaps, each over the same mix of notes,
+ * controllers, realtime and SysEx packets.
+ */
+
+#define FILTER_RULES	1
+
+#include "bench.h"
+#include "filter.c"
+
+#define CALLS	20000000UL
+
+config_t config;
+volatile uchar configBusy;
+
+static const uchar mix[8][4] = {
+	{0x09, 0x90, 0x3c, 0x64},
+	{0x08, 0x80, 0x3c, 0x40},
+	{0x09, 0x91, 0x24, 0x50},
+	{0x0b, 0xb0, 0x07, 0x7f},
+	{0x0e, 0xe2, 0x00, 0x40},
+	{0x0f, 0xf8, 0x00, 0x00},
+	{0x04, 0xf0, 0x7e, 0x00},
+	{0x0a, 0xa1, 0x30, 0x20}
+};
+
+static void run(const char *what)
+{
+	unsigned long i, sum = 0;
+	uchar p[4];
+	double t;
+
+	t = benchNow();
+	for (i = 0; i < CALLS; i++) {
+		memcpy(p, mix[i & 7], 4);
+		p[2] ^= i & 0x0f;
+		sum += filterPacket(FILTER_OUT, p) + p[2];
+	}
+	benchReport(what, t, CALLS);
+	benchSink += sum;
+}
+
+int main(void)
+{
+	filterRules_t *r = &config.filter[FILTER_OUT];
+
+	filterDefaults(&config.filter[FILTER_IN]);
+	filterDefaults(r);
+	run("packet, default rules");
+
+	r->block[0xb - 8][0] = 1 << 1;	/* controllers on channel 2 */
+	r->system[0] = 1 << 0;		/* SysEx */
+	r->notes[0] = 1 << 1;		/* channel 2: 0x30..0x60, up 12 */
+	r->noteLow = 0x30;
+	r->noteHigh = 0x60;
+	r->transpose = 12;
+	r->channel[1] = 9;		/* and on channel 10 */
+	run("packet, split and remap");
+
+	configBusy = 1;
+	run("packet, write in progress");
+	return 0;
+}
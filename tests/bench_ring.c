@@ -0,0 +1,53 @@
+/* Name: bench_ring.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+/* The ring operations of ring.h as the firmware uses them: one byte or
+ * one event in and out again, and the count that the tasks poll.
+ */
+
+#include "bench.h"
+#include "ring.h"
+
+#define CALLS	20000000UL
+
+RING_BYTES(bytes, 64)
+RING_EVENTS(events, 16)
+
+int main(void)
+{
+	ringEvent_t ev = { {0x09, 0x90, 0x3c, 0x64} }, *e;
+	unsigned long i, sum = 0;
+	double t;
+	uchar *p;
+
+	t = benchNow();
+	for (i = 0; i < CALLS; i++) {
+		bytesPut(i);
+		p = bytesPeek();
+		sum += *p;
+		bytesDrop();
+	}
+	benchReport("byte put, peek and drop", t, CALLS);
+
+	t = benchNow();
+	for (i = 0; i < CALLS; i++) {
+		ev.b[3] = i;
+		eventsPut(ev);
+		e = eventsPeek();
+		sum += e->b[3];
+		eventsDrop();
+	}
+	benchReport("event put, peek and drop", t, CALLS);
+
+	for (i = 0; i < 40; i++)
+		bytesPut(i);
+	t = benchNow();
+	for (i = 0; i < CALLS; i++)
+		sum += bytesCount() + bytesSpace();
+	benchReport("count and space", t, CALLS);
+
+	benchSink = sum;
+	return 0;
+}
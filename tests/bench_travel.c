@@ -0,0 +1,78 @@
+/* Name: bench_travel.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+/* Per key cost of the analog keybed: the ADC complete handler for a key
+ * at rest and for keys going through strike, aftertouch and release, and
+ * travelPoll() turning the results into events.
+ */
+
+#define TRAVEL_KEYS	16
+
+#include "bench.h"
+#include "travel.c"
+
+#define ROUNDS	500000UL
+
+static unsigned long queued;
+
+timestamp_t timebaseStamp(void)
+{
+	return 0;
+}
+
+uchar keymapVelocity(uchar v)
+{
+	return v;
+}
+
+uchar keymapPut(uchar cin, uchar k, uchar v, timestamp_t t)
+{
+	queued += cin + k + v;
+	return 1;
+}
+
+/* One scan round with every key at pos(round, key), settling conversions
+ * included.
+ */
+static void scan(unsigned long r, uchar moving)
+{
+	uchar k, pos;
+
+	for (k = 0; k < TRAVEL_KEYS; k++) {
+		pos = moving ? (r * 8 + k * 16) & 0xff : 0;
+		ADCH = pos;
+		ADC_vect();
+		ADCH = pos;
+		ADC_vect();
+	}
+}
+
+int main(void)
+{
+	unsigned long r;
+	double t;
+
+	travelInit();
+	t = benchNow();
+	for (r = 0; r < ROUNDS; r++)
+		scan(r, 0);
+	benchReport("ADC handler per key, at rest", t, ROUNDS * TRAVEL_KEYS);
+
+	t = benchNow();
+	for (r = 0; r < ROUNDS; r++)
+		scan(r, 1);
+	benchReport("ADC handler per key, playing", t, ROUNDS * TRAVEL_KEYS);
+
+	t = benchNow();
+	for (r = 0; r < ROUNDS; r++) {
+		scan(r, 1);
+		travelPoll();
+	}
+	benchReport("ADC handler and poll per key, playing", t,
+		    ROUNDS * TRAVEL_KEYS);
+
+	benchSink = queued;
+	return 0;
+}
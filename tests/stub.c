@@ -0,0 +1,61 @@
+/* Name: stub.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#define AVR_REG(type, name)	volatile type name;
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+#include "test.h"
+#include "bench.h"
+
+int testFailures;
+unsigned long eepromWrites;
+volatile unsigned long benchSink;
+
+uint8_t eeprom_read_byte(const uint8_t * p)
+{
+	return *p;
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+	memcpy(dst, src, n);
+}
+
+void eeprom_update_byte(uint8_t * p, uint8_t v)
+{
+	if (*p != v) {
+		*p = v;
+		eepromWrites++;
+	}
+}
+
+int eeprom_is_ready(void)
+{
+	return 1;
+}
+
+int testDone(const char *name)
+{
+	printf("%s: %s (%d failed)\n", name, testFailures ? "FAIL" : "ok",
+	       testFailures);
+	return testFailures != 0;
+}
+
+double benchNow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void benchReport(const char *what, double start, unsigned long calls)
+{
+	printf("%-36s %7.2f ns\n", what, (benchNow() - start) / calls);
+}
@@ -0,0 +1,59 @@
+/* Name: test.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __test_h_included__
+#define __test_h_included__
+
+/*
+General Description:
+Host tests for the parts of the firmware that do not need the hardware.
+Each test program includes the firmware file it tests, so it can reach the
+file's statics, and runs against the register and EEPROM stand-ins in
+avr/ and stub.c. Interrupt handlers are plain functions the test calls at
+the point it wants the interrupt to happen; cli() and sei() do nothing.
+Configuration options a test depends on are set before the includes.
+
+A check that fails prints its line and the test goes on; testDone() is
+the exit status of main().
+*/
+
+#include <stdio.h>
+
+#include "usbsafe.h"
+
+#undef USB_SAFE_ISR_MASKED
+#define USB_SAFE_ISR_MASKED(vect, reg, bit, body) \
+void vect(void) \
+{ \
+	reg &= ~(1 << (bit)); \
+	if (body()) \
+		reg |= (1 << (bit)); \
+}
+
+extern int testFailures;
+
+#define check(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			testFailures++; \
+		} \
+	} while (0)
+
+#define checkEqual(a, b) \
+	do { \
+		long _a = (a), _b = (b); \
+		if (_a != _b) { \
+			printf("%s:%d: %s is %ld, not %ld\n", __FILE__, \
+			       __LINE__, #a, _a, _b); \
+			testFailures++; \
+		} \
+	} while (0)
+
+int testDone(const char *name);
+/* Prints the result of the test and returns non-zero if a check failed.
+ */
+
+#endif				/* __test_h_included__ */
@@ -0,0 +1,255 @@
+/* Name: test_config.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+/* The configuration store on an emulated EEPROM: slot rotation, recovery
+ * from a cut save and from damaged slots, and the host and SysEx writes.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "test.h"
+#include "config.c"
+#include "filter.c"
+
+static uchar loads, released, releaseRoom = 1;
+
+void keymapLoad(void)
+{
+	loads++;
+}
+
+uchar keymapRelease(void)
+{
+	if (!configBusy)
+		released++;
+	return releaseRoom;
+}
+
+/* Runs configPoll() for n bytes of a save. */
+static void polls(unsigned n)
+{
+	while (n--)
+		configPoll();
+}
+
+static void save(signed char value)
+{
+	config.keymap.transpose = value;
+	configChanged();
+	polls(SLOT_SIZE);
+	checkEqual(savePos, SLOT_SIZE);
+}
+
+/* Boots on the EEPROM as it is and returns the transpose it found. */
+static signed char boot(void)
+{
+	memset(&config, 0x55, sizeof(config));
+	configInit();
+	return config.keymap.transpose;
+}
+
+/* Passes a note on for channel c through the DIN output rules. */
+static uchar noteOn(uchar c)
+{
+	uchar p[4] = { 0x09, 0x90 | c, 60, 100 };
+
+	return filterPacket(FILTER_OUT, p);
+}
+
+static uchar sysex(const uchar * packets, uchar n)
+{
+	uchar taken = 0, p[4];
+
+	for (; n; n--, packets += 4) {
+		memcpy(p, packets, 4);
+		taken += configSysex(p);
+	}
+	return taken;
+}
+
+int main(void)
+{
+	unsigned off = offsetof(config_t, keymap.velocity);
+	uchar buf[8], i, s;
+	unsigned r;
+
+	/* a blank EEPROM gives the defaults, the first save goes to slot 0 */
+	memset(store, 0xff, sizeof(store));
+	checkEqual(boot(), 0);
+	checkEqual(config.keymap.zone[0].high, 127);
+	checkEqual(config.keymap.zone[0].channel, KEYMAP_CHANNEL);
+	checkEqual(config.keymap.zone[1].low, KEYMAP_ZONE_OFF);
+	checkEqual(config.filter[FILTER_OUT].noteHigh, 127);
+	checkEqual(slot, CONFIG_SLOTS - 1);
+	polls(10);
+	checkEqual(eepromWrites, 0);	/* nothing changed, nothing written */
+
+	/* every save goes to the next slot and survives a reboot, also across
+	 * the wrap of the 8 bit sequence number
+	 */
+	for (r = 0; r < 300; r++) {
+		save(r & 0x3f);
+		checkEqual(slot, r % CONFIG_SLOTS);
+		if (r % 37 == 0 || r > 250) {
+			checkEqual(boot(), r & 0x3f);
+			checkEqual(slot, r % CONFIG_SLOTS);
+		}
+	}
+	check(eepromWrites <= 300UL * SLOT_SIZE);
+
+	/* a save cut short by a reset leaves the previous copy in charge */
+	s = slot;
+	config.keymap.transpose = 7;
+	configChanged();
+	polls(SLOT_SIZE - 1);	/* all but the checksum */
+	checkEqual(boot(), 299 & 0x3f);
+	checkEqual(slot, s);
+	save(8);
+	checkEqual(boot(), 8);
+
+	/* a damaged copy is passed over for the one before it */
+	s = slot;
+	store[s][5] ^= 0x01;
+	checkEqual(boot(), 299 & 0x3f);
+	checkEqual(slot, s ? s - 1 : CONFIG_SLOTS - 1);
+
+	/* so is the layout of another firmware version */
+	save(9);
+	store[slot][1] = CONFIG_VERSION + 1;
+	checkEqual(boot(), 299 & 0x3f);
+	for (i = 0; i < CONFIG_SLOTS; i++)
+		store[i][1] = CONFIG_VERSION + 1;
+	checkEqual(boot(), 0);
+	checkEqual(config.keymap.zone[0].high, 127);
+
+	/* host write in chunks, applied with the last one, bytes past
+	 * config_t dropped
+	 */
+	loads = 0;
+	configWriteBegin(off, 3);
+	buf[0] = 0x11;
+	checkEqual(configWrite(buf, 1), 0);
+	checkEqual(loads, 0);
+	configWriteBegin(sizeof(config) - 1, 9);
+	memset(buf, 0x22, 8);
+	checkEqual(configWrite(buf, 8), 0);
+	checkEqual(configWrite(buf, 1), 1);
+	checkEqual(loads, 1);
+	checkEqual(((uchar *) &config)[sizeof(config) - 1], 0x22);
+	check(dirty);
+	polls(SLOT_SIZE);
+	configReadBegin(sizeof(config) - 2, 8);
+	checkEqual(configRead(buf, 8), 2);
+	checkEqual(buf[1], 0x22);
+
+	/* while a write is coming in the rules are off, and the whole block
+	 * is applied after the last packet
+	 */
+	config.filter[FILTER_OUT].block[1][0] = 0x01;	/* 0x90, channel 1 */
+	check(!noteOn(0));
+	check(noteOn(1));
+	configWriteBegin(offsetof(config_t, filter[FILTER_OUT].block[1]), 2);
+	buf[0] = 0x02;
+	buf[1] = 0x00;
+	checkEqual(configWrite(buf, 1), 0);
+	check(configBusy);
+	check(noteOn(0));
+	check(noteOn(1));
+	checkEqual(configWrite(buf + 1, 1), 1);
+	check(!configBusy);
+	check(noteOn(0));
+	check(!noteOn(1));
+
+	/* a write releases the keys once, before its first byte; it stalls
+	 * with nothing written if their note offs do not fit
+	 */
+	released = 0;
+	configWriteBegin(off, 2);
+	buf[0] = 0x33;
+	buf[1] = 0x44;
+	checkEqual(configWrite(buf, 1), 0);
+	checkEqual(configWrite(buf + 1, 1), 1);
+	checkEqual(released, 1);
+	releaseRoom = 0;
+	configWriteBegin(off, 1);
+	checkEqual(configWrite(buf + 1, 1), 0xff);
+	check(!configBusy);
+	checkEqual((uchar) config.keymap.velocity, 0x33);
+	releaseRoom = 1;
+
+	/* a write the host gave up on is applied CONFIG_BUSY_MS later */
+	configWriteBegin(off, 2);
+	buf[0] = 0x02;
+	loads = 0;
+	checkEqual(configWrite(buf, 1), 0);
+	polls(CONFIG_BUSY_MS - 1);
+	check(configBusy);
+	checkEqual(loads, 0);
+	polls(1);
+	check(!configBusy);
+	checkEqual(loads, 1);
+	checkEqual((uchar) config.keymap.velocity, 0x02);
+	polls(SLOT_SIZE);
+
+	/* configuration SysEx: write, taken but not applied, not ours */
+	{
+		static const uchar write[] = {
+			0x04, 0xf0, 0x7d, SYSEX_ID,
+			0x04, 0x01, 0, 0,
+			0x07, 0x05, 0x0a, 0xf7
+		};
+		static const uchar read[] = {
+			0x04, 0xf0, 0x7d, SYSEX_ID,
+			0x04, 0x02, 0, 0,
+			0x07, 0x01, 0x02, 0xf7
+		};
+		static const uchar other[] = {
+			0x04, 0xf0, 0x7e, 0x00,
+			0x06, 0x01, 0xf7, 0
+		};
+		uchar msg[sizeof(write)];
+
+		memcpy(msg, write, sizeof(msg));
+		msg[6] = off >> 7;
+		msg[7] = off & 0x7f;
+		loads = 0;
+		checkEqual(sysex(msg, 3), 3);
+		checkEqual((uchar) config.keymap.velocity, 0x5a);
+		checkEqual(loads, 1);
+		checkEqual(sysex(read, 3), 3);
+		checkEqual((uchar) config.keymap.velocity, 0x5a);
+		checkEqual(loads, 1);
+		checkEqual(sysex(other, 2), 0);
+		polls(SLOT_SIZE);
+		checkEqual(boot(), config.keymap.transpose);
+		checkEqual((uchar) config.keymap.velocity, 0x5a);
+	}
+
+	/* the rules are off from the first data byte of a SysEx write to
+	 * its F7
+	 */
+	{
+		unsigned a = offsetof(config_t, filter[FILTER_OUT].block[1]);
+		uchar msg[] = {
+			0x04, 0xf0, 0x7d, SYSEX_ID,
+			0x04, 0x01, a >> 7, a & 0x7f,
+			0x04, 0x00, 0x04, 0x00,
+			0x05, 0xf7, 0, 0
+		};
+
+		check(noteOn(2));
+		checkEqual(sysex(msg, 3), 3);
+		check(configBusy);
+		check(noteOn(1));
+		check(noteOn(2));
+		checkEqual(sysex(msg + 12, 1), 1);
+		check(!configBusy);
+		check(noteOn(1));
+		check(!noteOn(2));
+	}
+
+	return testDone("config");
+}
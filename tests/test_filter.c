@@ -0,0 +1,106 @@
+/* Name: test_filter.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+/* The rule tables of filter.c applied to event packets. */
+
+#define FILTER_RULES	1
+
+#include <string.h>
+
+#include "test.h"
+#include "filter.c"
+
+config_t config;
+volatile uchar configBusy;
+
+/* Filters packet cin, b1, b2, b3 out; returns 0 or the resulting bytes. */
+static unsigned long out(uchar cin, uchar b1, uchar b2, uchar b3)
+{
+	uchar p[4] = { cin, b1, b2, b3 };
+
+	if (!filterPacket(FILTER_OUT, p))
+		return 0;
+	return (unsigned long) p[0] << 24 | (unsigned long) p[1] << 16 |
+	    p[2] << 8 | p[3];
+}
+
+int main(void)
+{
+	filterRules_t *r = &config.filter[FILTER_OUT];
+
+	filterDefaults(&config.filter[FILTER_IN]);
+	filterDefaults(r);
+
+	/* the defaults let everything through unchanged */
+	checkEqual(out(0x09, 0x90, 60, 100), 0x09903c64);
+	checkEqual(out(0x0b, 0xbf, 7, 127), 0x0bbf077f);
+	checkEqual(out(0x0e, 0xe3, 0, 64), 0x0ee30040);
+	checkEqual(out(0x0f, 0xf8, 0, 0), 0x0ff80000);
+	checkEqual(out(0x04, 0xf0, 1, 2), 0x04f00102);
+
+	/* packets whose CIN says channel message but whose status is not one
+	 * are dropped, whatever the tables hold
+	 */
+	checkEqual(out(0x09, 0x3c, 100, 0), 0);
+	checkEqual(out(0x0b, 0xf8, 0, 0), 0);
+	checkEqual(out(0x0e, 0xf0, 0, 0), 0);
+
+	/* block: controllers on channel 2 only */
+	r->block[0xb - 8][0] = 1 << 1;
+	checkEqual(out(0x0b, 0xb1, 7, 1), 0);
+	checkEqual(out(0x0b, 0xb0, 7, 1), 0x0bb00701);
+	checkEqual(out(0x09, 0x91, 60, 1), 0x09913c01);
+	r->block[0xb - 8][0] = 0;
+
+	/* channel map after everything else */
+	r->channel[1] = 9;
+	checkEqual(out(0x09, 0x91, 60, 1), 0x09993c01);
+	r->channel[1] = 1;
+
+	/* a split: channel 1 keeps notes from C4 up, an octave lower */
+	r->notes[0] = 1 << 0;
+	r->noteLow = 60;
+	r->noteHigh = 127;
+	r->transpose = -12;
+	checkEqual(out(0x09, 0x90, 59, 100), 0);
+	checkEqual(out(0x09, 0x90, 60, 100), 0x09903064);
+	checkEqual(out(0x08, 0x80, 72, 0), 0x08803c00);
+	checkEqual(out(0x0a, 0xa0, 72, 5), 0x0aa03c05);
+	checkEqual(out(0x0b, 0xb0, 59, 5), 0x0bb03b05);	/* not a note */
+	checkEqual(out(0x09, 0x91, 59, 100), 0x09913b64);	/* not ch. 1 */
+
+	/* notes moved out of 0..127 are dropped */
+	r->noteLow = 0;
+	checkEqual(out(0x09, 0x90, 11, 100), 0);
+	checkEqual(out(0x09, 0x90, 12, 100), 0x09900064);
+	r->transpose = 12;
+	checkEqual(out(0x09, 0x90, 116, 100), 0);
+	r->notes[0] = 0;
+	r->transpose = 0;
+
+	/* system: clock dropped, a blocked SysEx dropped across packets */
+	r->system[1] = 1 << (0xf8 - 0xf8);
+	checkEqual(out(0x0f, 0xf8, 0, 0), 0);
+	checkEqual(out(0x0f, 0xfa, 0, 0), 0x0ffa0000);
+	r->system[0] = 1 << 0;
+	checkEqual(out(0x04, 0xf0, 1, 2), 0);
+	checkEqual(out(0x04, 3, 4, 5), 0);
+	checkEqual(out(0x07, 6, 7, 0xf7), 0);
+	checkEqual(out(0x02, 0xf1, 0x23, 0), 0x02f12300);
+	r->system[0] = 0;
+	checkEqual(out(0x04, 0xf0, 1, 2), 0x04f00102);
+	checkEqual(out(0x06, 3, 0xf7, 0), 0x0603f700);
+
+	/* the directions have separate tables */
+	{
+		uchar p[4] = { 0x0f, 0xf8, 0, 0 };
+
+		check(filterPacket(FILTER_IN, p));
+		check(filterSystem(FILTER_OUT, 0xf8));
+		check(!filterSystem(FILTER_IN, 0xf8));
+	}
+
+	return testDone("filter");
+}
@@ -0,0 +1,110 @@
+/* Name: test_keymap.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+/* Key events through the map and its zones, and the note offs of the keys
+ * held when the configuration changes.
+ */
+
+#define KEYMAP_ZONES	2
+
+#include <string.h>
+
+#include "test.h"
+#include "keymap.c"
+
+config_t config;
+volatile uchar configBusy;
+
+static uchar down[KEYMAP_KEYS];
+static uchar queue[32][4];
+static uchar queued;
+
+timestamp_t timebaseStamp(void)
+{
+	return 0;
+}
+
+uchar keysDown(uchar key)
+{
+	return down[key];
+}
+
+uchar midiInEventDepth(void)
+{
+	return queued;
+}
+
+uchar midiInPutGroup(uchar * events, uchar n, timestamp_t t)
+{
+	if (MIDIIN_EVENT_SIZE - 1 - queued < n)
+		return 0;
+	memcpy(queue[queued], events, n * 4);
+	queued += n;
+	return 1;
+}
+
+/* Checks that event i is cin, status and note. */
+static void event(int line, uchar i, uchar cin, uchar s, uchar note)
+{
+	if (queue[i][0] != cin || queue[i][1] != s || queue[i][2] != note) {
+		printf("%s:%d: event %d is %02x %02x %d\n", __FILE__, line, i,
+		       queue[i][0], queue[i][1], queue[i][2]);
+		testFailures++;
+	}
+}
+
+#define EVENT(i, cin, s, note)	event(__LINE__, i, cin, s, note)
+
+int main(void)
+{
+	/* the defaults: one zone over all notes, the flash layout */
+	memset(&config, 0, sizeof(config));
+	config.keymap.zone[0].high = 127;
+	config.keymap.zone[1].low = KEYMAP_ZONE_OFF;
+	memset(config.keymap.note, KEYMAP_DEFAULT, KEYMAP_KEYS);
+	keymapLoad();
+	checkEqual(keymapPut(0x09, 0, 100, 0), 1);
+	checkEqual(queued, 1);
+	EVENT(0, 0x09, 0x90, KEYS_BASE_NOTE);
+
+	/* a layer on channel 2 an octave up */
+	config.keymap.zone[1].low = 0;
+	config.keymap.zone[1].high = 127;
+	config.keymap.zone[1].channel = 1;
+	config.keymap.zone[1].transpose = 12;
+	queued = 0;
+	checkEqual(keymapPut(0x09, 1, 100, 0), 1);
+	checkEqual(queued, 2);
+	EVENT(1, 0x09, 0x91, KEYS_BASE_NOTE + 14);
+
+	/* keys held when the map changes get their note offs under the old
+	 * map and zones, all of them or none
+	 */
+	down[0] = down[2] = 1;
+	queued = MIDIIN_EVENT_SIZE - 4;
+	checkEqual(keymapRelease(), 0);
+	checkEqual(queued, MIDIIN_EVENT_SIZE - 4);
+	queued = 0;
+	checkEqual(keymapRelease(), 1);
+	checkEqual(queued, 4);
+	EVENT(0, 0x08, 0x80, KEYS_BASE_NOTE);
+	EVENT(1, 0x08, 0x81, KEYS_BASE_NOTE + 12);
+	EVENT(2, 0x08, 0x80, KEYS_BASE_NOTE + 4);
+	EVENT(3, 0x08, 0x81, KEYS_BASE_NOTE + 16);
+
+	/* silent keys, and all keys while a write comes in */
+	config.keymap.note[2] = 0x80;
+	keymapLoad();
+	queued = 0;
+	checkEqual(keymapRelease(), 1);
+	checkEqual(queued, 2);
+	configBusy = 1;
+	queued = 0;
+	checkEqual(keymapPut(0x09, 0, 100, 0), 1);
+	checkEqual(keymapRelease(), 1);
+	checkEqual(queued, 0);
+
+	return testDone("keymap");
+}
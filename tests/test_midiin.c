@@ -0,0 +1,156 @@
+/* Name: test_midiin.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+/* The DIN input path: bytes go in through the USART receive handler and
+ * come out of midiInPacket() as USB-MIDI event packets.
+ */
+
+#define FILTER_RULES	0
+
+#include <string.h>
+
+#include "test.h"
+#include "midiin.c"
+
+static timestamp_t now;
+
+timestamp_t timebaseStamp(void)
+{
+	return now;
+}
+
+static void receive(const uchar * bytes, uchar n)
+{
+	while (n--) {
+		UDR0 = *bytes++;
+		USART_RX_vect();
+		now += 80;	/* 320 us per byte at 31.25 kbaud */
+	}
+}
+
+/* Parses everything received and checks the packets that come out. */
+static void expect(int line, const uchar * packets, uchar n)
+{
+	uchar buf[8], got[64], len = 0, i;
+
+	while (midiInPoll())
+		;
+	while ((i = midiInPacket(buf)) && len + i <= sizeof(got)) {
+		memcpy(got + len, buf, i);
+		len += i;
+	}
+	if (len != n || memcmp(got, packets, n)) {
+		printf("%s:%d: got", __FILE__, line);
+		for (i = 0; i < len; i++)
+			printf(" %02x", got[i]);
+		printf("\n");
+		testFailures++;
+	}
+}
+
+#define RECEIVE(...) \
+	do { \
+		static const uchar b[] = { __VA_ARGS__ }; \
+		receive(b, sizeof(b)); \
+	} while (0)
+#define EXPECT(...) \
+	do { \
+		static const uchar p[] = { __VA_ARGS__ }; \
+		expect(__LINE__, p, sizeof(p)); \
+	} while (0)
+#define EXPECT_NONE()	expect(__LINE__, 0, 0)
+
+int main(void)
+{
+	uchar buf[8], i, n;
+
+	midiInInit();
+
+	RECEIVE(0x90, 0x3c, 0x64);
+	EXPECT(0x09, 0x90, 0x3c, 0x64);
+
+	/* running status, note on with velocity 0 stays a note on */
+	RECEIVE(0x3e, 0x40, 0x3e, 0x00);
+	EXPECT(0x09, 0x90, 0x3e, 0x40, 0x09, 0x90, 0x3e, 0x00);
+
+	/* realtime inside a message goes first and does not break it */
+	RECEIVE(0xb1, 0x07, 0xf8, 0x7f);
+	EXPECT(0x0f, 0xf8, 0x00, 0x00, 0x0b, 0xb1, 0x07, 0x7f);
+
+	/* program change and channel pressure have one data byte */
+	RECEIVE(0xc2, 0x05, 0x06, 0xd3, 0x40);
+	EXPECT(0x0c, 0xc2, 0x05, 0x00, 0x0c, 0xc2, 0x06, 0x00,
+	       0x0d, 0xd3, 0x40, 0x00);
+
+	/* SysEx in threes, the end packet says how many bytes it holds */
+	RECEIVE(0xf0, 0x7d, 0x01, 0x02, 0xf7);
+	EXPECT(0x04, 0xf0, 0x7d, 0x01, 0x06, 0x02, 0xf7, 0x00);
+	RECEIVE(0xf0, 0x7d, 0xf7);
+	EXPECT(0x07, 0xf0, 0x7d, 0xf7);
+	RECEIVE(0xf0, 0x01, 0x02, 0x03, 0x04, 0xf7);
+	EXPECT(0x04, 0xf0, 0x01, 0x02, 0x07, 0x03, 0x04, 0xf7);
+
+	/* a status byte aborts a SysEx; its bytes so far are gone */
+	RECEIVE(0xf0, 0x01, 0x80, 0x3c, 0x00);
+	EXPECT(0x08, 0x80, 0x3c, 0x00);
+
+	/* system common ends running status, a lone data byte is dropped */
+	RECEIVE(0xf2, 0x01, 0x02, 0x03);
+	EXPECT(0x03, 0xf2, 0x01, 0x02);
+	RECEIVE(0xf1, 0x23, 0xf6, 0xf4);
+	EXPECT(0x02, 0xf1, 0x23, 0x00, 0x05, 0xf6, 0x00, 0x00);
+
+	/* a stray end of exclusive does nothing */
+	RECEIVE(0xf7);
+	EXPECT_NONE();
+
+	/* a pair shares a packet, a realtime byte never splits it */
+	midiInPutPair(0x0b, 0xb0, 0x07, 0x10, 0x27, 0x20);
+	midiInPut(0x0b, 0xb0, 0x01, 0x02);
+	RECEIVE(0xfa);
+	checkEqual(midiInPacket(buf), 4);
+	checkEqual(buf[1], 0xfa);
+	checkEqual(midiInPacket(buf), 8);
+	checkEqual(buf[2], 0x07);
+	checkEqual(buf[6], 0x27);
+	checkEqual(midiInPacket(buf), 4);
+	checkEqual(buf[2], 0x01);
+
+	/* a full event queue holds the bytes back instead of losing them */
+	for (i = 0; i < MIDIIN_EVENT_SIZE + 4; i++) {
+		UDR0 = 0xa0;
+		USART_RX_vect();
+		UDR0 = i;
+		USART_RX_vect();
+		UDR0 = 0x10;
+		USART_RX_vect();
+		while (midiInPoll())
+			;
+	}
+	checkEqual(midiInEventDepth(), MIDIIN_EVENT_SIZE - 1);
+	checkEqual(midiInDepth(), 5 * 3 - 2);	/* status, key parsed */
+	checkEqual(midiInStats.rxOverruns, 0);
+	for (n = 0;; n++) {
+		while (midiInPoll())
+			;
+		if (!midiInPacket(buf))
+			break;
+		checkEqual(buf[2], 2 * n);
+		checkEqual(buf[6], 2 * n + 1);
+	}
+	checkEqual(n, (MIDIIN_EVENT_SIZE + 4) / 2);
+
+	/* more bytes than the receive ring holds are counted as overruns */
+	RECEIVE(0xf6);
+	EXPECT(0x05, 0xf6, 0x00, 0x00);
+	for (i = 0; i < MIDIIN_RX_SIZE + 2; i++) {
+		UDR0 = 0x10;
+		USART_RX_vect();
+	}
+	checkEqual(midiInStats.rxOverruns, 3);
+	EXPECT_NONE();
+
+	return testDone("midiin");
+}
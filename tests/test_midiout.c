@@ -0,0 +1,203 @@
+/* Name: test_midiout.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+/* The DIN output path: packets go in through midiOutPacket(), bytes come
+ * out of the USART data register empty handler.
+ */
+
+#define MIDIOUT_THIN	4
+#define MIDIOUT_NOTES	1
+#define FILTER_RULES	0
+
+#include <string.h>
+
+#include "test.h"
+#include "midiout.c"
+
+static uchar synced = 1;
+
+timebase_t timebaseNow(void)
+{
+	return 0;
+}
+
+uchar timebaseSynced(void)
+{
+	return synced;
+}
+
+static void send(uchar cin, uchar b1, uchar b2, uchar b3)
+{
+	uchar p[4] = { cin, b1, b2, b3 };
+
+	midiOutPacket(p);
+}
+
+/* Runs the transmitter until the queue is empty, returns the bytes sent. */
+static uchar wire(uchar * buf)
+{
+	uchar n = 0;
+
+	for (;;) {
+		UDR0 = 0;
+		USART_UDRE_vect();
+		if (!(UCSR0B & (1 << UDRIE0)))
+			break;
+		buf[n++] = UDR0;
+	}
+	return n;
+}
+
+/* Checks the bytes sent against the list, reports line on a mismatch. */
+static void expect(int line, const uchar * bytes, uchar n)
+{
+	uchar got[128], len = wire(got), i;
+
+	if (len != n || memcmp(got, bytes, n)) {
+		printf("%s:%d: sent", __FILE__, line);
+		for (i = 0; i < len; i++)
+			printf(" %02x", got[i]);
+		printf("\n");
+		testFailures++;
+	}
+}
+
+#define EXPECT(...) \
+	do { \
+		static const uchar b[] = { __VA_ARGS__ }; \
+		expect(__LINE__, b, sizeof(b)); \
+	} while (0)
+
+static void thinning(void)
+{
+	uchar v;
+
+	/* values queue until MIDIOUT_THIN_LEVEL bytes wait, then the newest
+	 * one replaces the one still waiting
+	 */
+	for (v = 0; v < 10; v++)
+		send(0x0b, 0xb0, 7, v);
+	checkEqual(midiOutDepth(), 17);
+	send(0x0e, 0xe0, 1, 2);
+	send(0x0e, 0xe0, 3, 4);
+	checkEqual(midiOutDepth(), 20);
+	send(0x0b, 0xb1, 7, 5);
+	checkEqual(midiOutDepth(), 23);
+
+	/* a note ends the thinning on its channel only */
+	send(0x09, 0x90, 60, 100);
+	send(0x0b, 0xb0, 7, 10);
+	checkEqual(midiOutDepth(), 29);
+	send(0x0b, 0xb1, 7, 6);
+	checkEqual(midiOutDepth(), 29);
+
+	/* SysEx ends it on all channels, realtime does not */
+	send(0x04, 0xf0, 0x7d, 0x01);
+	send(0x05, 0xf7, 0, 0);
+	send(0x0b, 0xb1, 7, 7);
+	checkEqual(midiOutDepth(), 36);
+	send(0x0f, 0xf8, 0, 0);
+	send(0x0b, 0xb1, 7, 8);
+	checkEqual(midiOutDepth(), 36);
+
+	/* data entry is never thinned */
+	send(0x0b, 0xb1, 6, 1);
+	send(0x0b, 0xb1, 6, 2);
+	checkEqual(midiOutDepth(), 40);
+
+	EXPECT(0xf8,
+	       0xb0, 7, 0, 7, 1, 7, 2, 7, 3, 7, 4, 7, 5, 7, 6, 7, 9,
+	       0xe0, 3, 4,
+	       0xb1, 7, 6,
+	       0x90, 60, 100,
+	       0xb0, 7, 10,
+	       0xf0, 0x7d, 0x01, 0xf7,
+	       0xb1, 7, 8,
+	       6, 1, 6, 2);
+
+	/* values that went out are not written over, running status stays */
+	for (v = 0; v < 12; v++)
+		send(0x0b, 0xb1, 7, v);
+	checkEqual(midiOutDepth(), 16);
+	EXPECT(7, 0, 7, 1, 7, 2, 7, 3, 7, 4, 7, 5, 7, 6, 7, 11);
+}
+
+static void panic(void)
+{
+	uchar i;
+
+	midiOutPoll();		/* frames are coming */
+	send(0x09, 0x90, 60, 100);
+	send(0x09, 0x92, 64, 100);
+	send(0x09, 0x90, 67, 100);
+	send(0x08, 0x80, 67, 0);
+	EXPECT(0x90, 60, 100, 0x92, 64, 100, 0x90, 67, 100, 0x80, 67, 0);
+
+	/* a note played after the panic started is left for the next one;
+	 * the map is shared, so each channel gets both note offs
+	 */
+	midiOutPanic();
+	send(0x09, 0x95, 1, 100);
+	midiOutPoll();
+	EXPECT(0x95, 1, 100,
+	       0xb0, 64, 0, 123, 0, 0x80, 60, 0, 64, 0,
+	       0xb2, 64, 0, 123, 0, 0x82, 60, 0, 64, 0);
+	midiOutPanic();
+	midiOutPoll();
+	EXPECT(0xb5, 64, 0, 123, 0, 0x85, 1, 0);
+	midiOutPoll();
+	EXPECT();
+
+	/* the frames stop */
+	send(0x09, 0x93, 2, 100);
+	synced = 0;
+	midiOutPoll();
+	EXPECT(0x93, 2, 100, 0xb3, 64, 0, 123, 0, 0x83, 2, 0);
+	synced = 1;
+	midiOutPoll();
+
+	/* a host that sent active sensing falls silent */
+	send(0x0f, 0xfe, 0, 0);
+	send(0x09, 0x94, 3, 100);
+	for (i = 1; i < SENSE_TICKS; i++)
+		midiOutPoll();
+	EXPECT(0xfe, 0x94, 3, 100);
+	midiOutPoll();
+	EXPECT(0xb4, 64, 0, 123, 0, 0x84, 3, 0);
+}
+
+/* Puts an event straight into the schedule, after those already there. */
+static void schedule(timebase_t t, uchar cin, uchar b1, uchar b2, uchar b3)
+{
+	uchar ev[4] = { cin, b1, b2, b3 };
+
+	schedTime[schedCount] = t;
+	memcpy(schedEvent[schedCount++], ev, 4);
+}
+
+static void scheduled(void)
+{
+	/* the map follows what went out: a note off still in the schedule
+	 * when the panic drops it does not take the note out of the map
+	 */
+	schedule(0, 0x09, 0x96, 70, 100);
+	schedule(1000, 0x08, 0x86, 70, 0);
+	TIMER0_COMPA_vect();
+	EXPECT(0x96, 70, 100);
+	checkEqual(schedCount, 1);
+	midiOutPanic();
+	checkEqual(schedCount, 0);
+	midiOutPoll();
+	EXPECT(0xb6, 64, 0, 123, 0, 0x86, 70, 0);
+}
+
+int main(void)
+{
+	midiOutInit();
+	thinning();
+	panic();
+	scheduled();
+	return testDone("midiout");
+}
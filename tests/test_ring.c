@@ -0,0 +1,90 @@
+/* Name: test_ring.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+/* Index arithmetic of the rings in ring.h, across the wrap of the indices
+ * and at the smallest and largest sizes.
+ */
+
+#include "test.h"
+#include "ring.h"
+
+RING_BYTES(small, 8)
+RING_BYTES(large, 256)
+RING_EVENTS(event, 4)
+
+int main(void)
+{
+	ringEvent_t ev = { {0x09, 0x90, 0x3c, 0x64} }, *e;
+	uchar *p, i, n, next = 0, expect = 0;
+	unsigned k;
+
+	checkEqual(smallCount(), 0);
+	checkEqual(smallSpace(), 7);
+	check(!smallPeek());
+
+	/* holds size - 1, then refuses without touching the buffer */
+	for (i = 0; i < 7; i++)
+		check(smallPut(i));
+	check(!smallPut(99));
+	check(!smallSlot());
+	checkEqual(smallCount(), 7);
+	checkEqual(smallSpace(), 0);
+	checkEqual(smallHigh, 7);
+	for (i = 0; i < 7; i++) {
+		p = smallPeek();
+		check(p && *p == i);
+		smallDrop();
+	}
+	check(!smallPeek());
+
+	/* Count() and Space() stay consistent while head wraps behind tail */
+	for (k = 0; k < 1000; k++) {
+		n = k % 5 + 1;
+		for (i = 0; i < n && smallPut(next); i++)
+			next++;
+		checkEqual(smallCount() + smallSpace(), 7);
+		for (i = 0; i < (k * 7) % 4 + 1 && (p = smallPeek()); i++) {
+			checkEqual(*p, expect);
+			expect++;
+			smallDrop();
+		}
+		check(smallHead < 8 && smallTail < 8);
+	}
+
+	/* with 256 elements the byte indices wrap by themselves */
+	largeReset();
+	for (k = 0; k < 600; k++) {
+		check(largePut(k));
+		p = largePeek();
+		check(p && *p == (uchar) k);
+		largeDrop();
+	}
+	for (i = 0; largePut(i); i++)
+		;
+	checkEqual(i, 255);
+	checkEqual(largeCount(), 255);
+	checkEqual(largeSpace(), 0);
+	largeReset();
+	checkEqual(largeCount(), 0);
+	checkEqual(largeHigh, 0);
+
+	/* events are filled and read in place */
+	for (i = 0; i < 3; i++) {
+		e = eventSlot();
+		check(e != 0);
+		*e = ev;
+		e->b[3] = i;
+		eventCommit();
+	}
+	check(!eventSlot());
+	for (i = 0; i < 3; i++) {
+		e = eventPeek();
+		check(e && e->b[1] == 0x90 && e->b[3] == i);
+		eventDrop();
+	}
+	checkEqual(eventHigh, 3);
+
+	return testDone("ring");
+}
@@ -0,0 +1,156 @@
+/* Name: test_travel.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+/* The analog keybed: key positions go in through the ADC complete handler,
+ * note on, note off and aftertouch come out of travelPoll().
+ */
+
+#define TRAVEL_KEYS	8
+
+#include "test.h"
+#include "travel.c"
+
+typedef struct {
+	uchar cin, key, v;
+} sent_t;
+
+static sent_t sent[16];
+static uchar sentCount;
+static uchar position[TRAVEL_KEYS];
+
+timestamp_t timebaseStamp(void)
+{
+	return 0;
+}
+
+uchar keymapVelocity(uchar v)
+{
+	return v;
+}
+
+uchar keymapPut(uchar cin, uchar k, uchar v, timestamp_t t)
+{
+	if (sentCount < 16) {
+		sent[sentCount].cin = cin;
+		sent[sentCount].key = k - KEYS_COUNT;
+		sent[sentCount].v = v;
+		sentCount++;
+	}
+	return 1;
+}
+
+/* Samples every key once at its position. The settling conversion after
+ * each select still reads the key before, and must be thrown away.
+ */
+static void scanRounds(unsigned n)
+{
+	uchar k, last = 0;
+
+	while (n--) {
+		for (k = 0; k < TRAVEL_KEYS; k++) {
+			check(key & SETTLE);
+			ADCH = last;
+			ADC_vect();
+			ADCH = last = position[key];
+			ADC_vect();
+		}
+	}
+}
+
+static void poll(void)
+{
+	sentCount = 0;
+	travelPoll();
+}
+
+int main(void)
+{
+	uchar i;
+
+	travelInit();
+	scanRounds(2);
+	poll();
+	checkEqual(sentCount, 0);
+
+	/* struck within one round: full velocity */
+	position[0] = TRAVEL_STRIKE;
+	scanRounds(2);
+	poll();
+	checkEqual(sentCount, 1);
+	checkEqual(sent[0].cin, 0x09);
+	checkEqual(sent[0].key, 0);
+	checkEqual(sent[0].v, 127);
+
+	/* 16 rounds from TRAVEL_START to TRAVEL_STRIKE */
+	position[1] = TRAVEL_START;
+	scanRounds(16);
+	position[1] = TRAVEL_STRIKE;
+	scanRounds(1);
+	poll();
+	checkEqual(sentCount, 1);
+	checkEqual(sent[0].key, 1);
+	checkEqual(sent[0].v, TRAVEL_VELOCITY / 16);
+
+	/* a key held half way for ever still plays: the count stops at 254 */
+	position[2] = TRAVEL_STRIKE - 1;
+	scanRounds(300);
+	position[2] = TRAVEL_STRIKE;
+	scanRounds(1);
+	poll();
+	checkEqual(sentCount, 1);
+	checkEqual(sent[0].v, TRAVEL_VELOCITY / 254);
+
+	/* a key let go before the strike does not sound */
+	position[3] = TRAVEL_START;
+	scanRounds(3);
+	position[3] = TRAVEL_RELEASE - 1;
+	scanRounds(1);
+	position[3] = TRAVEL_START - 1;
+	scanRounds(1);
+	poll();
+	checkEqual(sentCount, 0);
+
+	/* release */
+	position[1] = TRAVEL_RELEASE - 1;
+	scanRounds(1);
+	poll();
+	checkEqual(sentCount, 1);
+	checkEqual(sent[0].cin, 0x08);
+	checkEqual(sent[0].key, 1);
+
+	/* aftertouch past TRAVEL_AT_DEPTH, limited in rate, 0 when it rises */
+	position[0] = 255;
+	scanRounds(1);
+	poll();
+	checkEqual(sentCount, 1);
+	checkEqual(sent[0].cin, 0x0a);
+	checkEqual(sent[0].key, 0);
+	checkEqual(sent[0].v, (255 - TRAVEL_AT_DEPTH) * AT_SCALE >> 8);
+	check(sent[0].v >= 126);
+	position[0] = TRAVEL_AT_DEPTH + 10;
+	scanRounds(1);
+	for (i = 0; i < TRAVEL_AT_INTERVAL; i++) {
+		poll();
+		checkEqual(sentCount, 0);
+	}
+	poll();
+	checkEqual(sentCount, 1);
+	checkEqual(sent[0].v, 10 * AT_SCALE >> 8);
+	position[0] = TRAVEL_STRIKE;
+	scanRounds(1);
+	for (i = 0; i <= TRAVEL_AT_INTERVAL; i++)
+		poll();
+	checkEqual(sentCount, 1);
+	checkEqual(sent[0].v, 0);
+
+	/* the note off resets the aftertouch for the next note */
+	position[0] = 0;
+	scanRounds(1);
+	poll();
+	checkEqual(sentCount, 1);
+	checkEqual(sent[0].cin, 0x08);
+
+	return testDone("travel");
+}
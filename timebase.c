@@ -0,0 +1,168 @@
+/* Name: timebase.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "usbdrv.h"
+#include "timebase.h"
+
+#if !USB_COUNT_SOF
+#error "timebase needs USB_COUNT_SOF and USB_SOF_HOOK in usbconfig.h"
+#endif
+
+#define MEASURE_FRAMES	64	/* frames per frame length update */
+#define MEASURE_SLACK	12	/* max deviation of one frame, in ticks */
+#define SYNC_TIMEOUT	(3 * TIMEBASE_FRAME_TICKS)
+
+volatile uchar timebaseSofTick;
+
+/* Device time is refMs plus whatever elapsed since. Synced, that is the
+ * frames counted since refSof plus the ticks since the last frame. Free
+ * running, it is freePhase plus the ticks since the last poll. Only the
+ * main loop writes these, and only with interrupts disabled, so that
+ * timebaseNow() sees a consistent set from any context.
+ */
+static timebase_t refMs;
+static uchar refSof;
+static uchar synced;
+static unsigned long freePhase;	/* ticks since refMs, 24.8 */
+static uchar lastTick;		/* TCNT0 at the previous poll */
+
+/* frame length measurement, main loop only */
+static uchar lastSof, lastSofTick;
+static unsigned idleTicks;	/* ticks since a frame was last seen */
+static unsigned measureSum;
+static uchar measureCount;
+static unsigned framePeriod;	/* ticks per frame, 8.8 */
+static unsigned fracScale;	/* 1/256 ms per tick, 8.8 */
+
+/*---------------------------------------------------------------------------*/
+
+static void setFramePeriod(unsigned period)
+{
+	framePeriod = period;
+	fracScale = 0x1000000UL / period;
+}
+
+void timebaseInit(void)
+{
+	TCCR0A = 0;
+	TCCR0B = (1 << CS01) | (1 << CS00);	/* free running, F_CPU / 64 */
+	setFramePeriod(F_CPU * 256UL / TIMEBASE_PRESCALE / 1000);
+	refMs = 0;
+	freePhase = 0;
+	synced = 0;
+	idleTicks = 0;
+	measureSum = 0;
+	measureCount = 0;
+	lastTick = TCNT0;
+	lastSof = refSof = usbSofCount;
+	lastSofTick = timebaseSofTick;
+}
+
+timebase_t timebaseNow(void)
+{
+	timebase_t ms;
+	unsigned ticks;
+	unsigned long frac;
+	uchar sreg, tick;
+
+	sreg = SREG;
+	cli();
+	tick = TCNT0;
+	if (synced) {
+		ms = refMs + (uchar) (usbSofCount - refSof);
+		ticks = (uchar) (tick - timebaseSofTick);
+	} else {
+		ms = refMs;
+		ticks = (unsigned) (freePhase >> 8) + (uchar) (tick - lastTick);
+	}
+	SREG = sreg;
+	frac = ((unsigned long) ticks * fracScale) >> 8;
+	if (frac > 255)		/* late frame: hold until it arrives */
+		frac = 255;
+	return (ms << 8) | (uchar) frac;
+}
+
+timestamp_t timebaseStamp(void)
+{
+	return (timestamp_t) timebaseNow();
+}
+
+uchar timebaseSynced(void)
+{
+	return synced;
+}
+
+void timebasePoll(void)
+{
+	timebase_t ms;
+	unsigned long phase;
+	uchar sreg, sof, sofTick, tick, delta, frames;
+
+	sreg = SREG;
+	cli();
+	sof = usbSofCount;
+	sofTick = timebaseSofTick;
+	tick = TCNT0;
+	SREG = sreg;
+	delta = tick - lastTick;
+	frames = sof - lastSof;
+
+	if (frames) {
+		if (frames == 1 && synced) {	/* saw both ends of one frame */
+			delta = sofTick - lastSofTick;
+			if (delta > TIMEBASE_FRAME_TICKS - MEASURE_SLACK &&
+			    delta < TIMEBASE_FRAME_TICKS + MEASURE_SLACK) {
+				measureSum += delta;
+				if (++measureCount == MEASURE_FRAMES) {
+					setFramePeriod(measureSum *
+						       (256 / MEASURE_FRAMES));
+					measureSum = 0;
+					measureCount = 0;
+				}
+			}
+		}
+		if (synced)
+			ms = refMs + (uchar) (sof - refSof);
+		else
+			ms = refMs + 1;	/* stay monotonic across the switch */
+		cli();
+		refMs = ms;
+		refSof = sof;
+		lastTick = tick;
+		synced = 1;
+		SREG = sreg;
+		lastSof = sof;
+		lastSofTick = sofTick;
+		idleTicks = 0;
+		return;
+	}
+
+	idleTicks += delta;
+	if (synced && idleTicks <= SYNC_TIMEOUT) {
+		lastTick = tick;
+		return;
+	}
+	if (synced) {		/* frames stopped: continue from the last one */
+		ms = refMs + (uchar) (sof - refSof);
+		phase = (unsigned long) idleTicks << 8;
+	} else {
+		ms = refMs;
+		phase = freePhase + ((unsigned) delta << 8);
+	}
+	while (phase >= framePeriod) {
+		phase -= framePeriod;
+		ms++;
+	}
+	cli();
+	refMs = ms;
+	refSof = sof;
+	freePhase = phase;
+	lastTick = tick;
+	synced = 0;
+	SREG = sreg;
+}
@@ -0,0 +1,58 @@
+/* Name: timebase.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __timebase_h_included__
+#define __timebase_h_included__
+
+/*
+General Description:
+Device time locked to the host. The host marks every USB frame with a
+keep-alive (low speed "SOF") once per millisecond; V-USB counts these in
+usbSofCount and the USB_SOF_HOOK in usbconfig.h latches Timer0 at each one.
+Whole milliseconds are frames, the fraction is interpolated from Timer0
+(F_CPU / 64, 5.33 us at 12 MHz) scaled by the measured frame length, so the
+crystal's drift against the host is corrected every 64 frames.
+
+Without frames (before enumeration, in suspend) the time free-runs from
+Timer0 with the last measured frame length. Free-running requires
+timebasePoll() at least every 1.3 ms (one Timer0 wrap).
+
+Time values are 24.8 fixed point milliseconds: bits 31..8 count frames,
+bits 7..0 are 1/256 ms (3.9 us). Stamps are the low 16 bits of that, which
+is enough to order and space events within 256 ms.
+*/
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+#define TIMEBASE_PRESCALE	64
+#define TIMEBASE_TICKS_US	(TIMEBASE_PRESCALE * 1000000.0 / F_CPU)
+#define TIMEBASE_FRAME_TICKS	(F_CPU / TIMEBASE_PRESCALE / 1000)	/* nominal */
+
+typedef unsigned long	timebase_t;
+typedef unsigned	timestamp_t;
+
+extern volatile uchar timebaseSofTick;	/* TCNT0 at the last frame, set by USB_SOF_HOOK */
+
+void timebaseInit(void);
+/* Starts Timer0. Call before usbInit().
+ */
+void timebasePoll(void);
+/* Rebases the frame counter, tracks the frame length and free-runs the time
+ * if no frames arrive. Call from the main loop, or from busy waits before
+ * interrupts are enabled.
+ */
+timebase_t timebaseNow(void);
+/* Current device time in 1/256 ms. Safe to call from interrupts.
+ */
+timestamp_t timebaseStamp(void);
+/* Low 16 bits of timebaseNow(). Safe to call from interrupts.
+ */
+uchar timebaseSynced(void);
+/* Non-zero while host frames are arriving.
+ */
+
+#endif				/* __timebase_h_included__ */
@@ -0,0 +1,185 @@
+/* Name: travel.c
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#include <avr/io.h>
+
+#include "travel.h"
+#include "keymap.h"
+#include "timebase.h"
+#include "usbsafe.h"
+#include "ring.h"
+
+#if TRAVEL_KEYS
+
+#if ANALOG_COUNT
+#error "analog.c and travel.c both need the ADC"
+#endif
+#define INPUTS		((TRAVEL_KEYS + 7) / 8)
+#if TRAVEL_ADC_FIRST + INPUTS > 6
+#error "not enough ADC inputs for TRAVEL_KEYS"
+#endif
+#if KEYS_DRIVER == KEYS_MATRIX && TRAVEL_ADC_FIRST < KEYS_ROWS
+#error "ADC inputs overlap the key matrix rows"
+#endif
+#if TRAVEL_RELEASE >= TRAVEL_START || TRAVEL_START >= TRAVEL_STRIKE || \
+    TRAVEL_AT_DEPTH <= TRAVEL_STRIKE
+#error "TRAVEL_RELEASE < TRAVEL_START < TRAVEL_STRIKE < TRAVEL_AT_DEPTH"
+#endif
+
+#define ADMUX_BASE	((1 << REFS0) | (1 << ADLAR))	/* AVcc, 8 bit in ADCH */
+#define MUX_SHIFT	5		/* select lines on PD5..PD7 */
+#define MUX_MASK	(7 << MUX_SHIFT)
+
+/* depth past TRAVEL_AT_DEPTH to pressure 0..127, 8.8 fixed point */
+#define AT_SCALE	(127U * 256 / (255 - TRAVEL_AT_DEPTH))
+
+#define REST		0
+#define ARMED		1
+#define DOWN		2
+
+#define SETTLE		0x80	/* key: the conversion after select() */
+
+/* key events: interrupt -> main, key << 8 | rounds, rounds 0 = note off */
+RING_DEFINE(travel, unsigned, 16)
+
+static uchar state[TRAVEL_KEYS];	/* interrupt only */
+static uchar armed[TRAVEL_KEYS];	/* scan round it passed TRAVEL_START */
+static volatile uchar pressure[TRAVEL_KEYS];	/* interrupt -> main */
+static uchar sentPressure[TRAVEL_KEYS];	/* main only */
+static uchar atWait[TRAVEL_KEYS];	/* ms until aftertouch may be sent */
+
+static uchar key;		/* key being converted, | SETTLE */
+static uchar scanRound;		/* complete scans, wraps */
+
+static void select(uchar k)
+{
+	PORTD = (PORTD & ~MUX_MASK) | ((k & 7) << MUX_SHIFT);
+	ADMUX = ADMUX_BASE | (TRAVEL_ADC_FIRST + (k >> 3));
+}
+
+void travelInit(void)
+{
+	DDRD |= MUX_MASK;
+	DIDR0 = ((1 << INPUTS) - 1) << TRAVEL_ADC_FIRST;
+	PORTC &= ~DIDR0;	/* no pull-ups on the analog inputs */
+	travelReset();
+	key = SETTLE;
+	select(0);
+	ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADIE) | TRAVEL_ADPS;
+}
+
+uchar travelDown(uchar k)
+{
+	return state[k] == DOWN;
+}
+
+uchar travelPoll(void)
+{
+	unsigned *e;
+	uchar k, rounds, v, p;
+
+	while ((e = travelPeek())) {
+		k = *e >> 8;
+		rounds = *e;
+		if (rounds) {
+			v = (TRAVEL_VELOCITY / rounds > 127) ?
+			    127 : TRAVEL_VELOCITY / rounds;
+			if (!v)
+				v = 1;
+			if (!keymapPut(0x09, KEYS_COUNT + k, keymapVelocity(v),
+				       timebaseStamp()))
+				return 1;
+		} else {
+			if (!keymapPut(0x08, KEYS_COUNT + k, 0x40,
+				       timebaseStamp()))
+				return 1;
+			sentPressure[k] = 0;
+		}
+		travelDrop();
+	}
+	for (k = 0; k < TRAVEL_KEYS; k++) {
+		if (atWait[k]) {
+			atWait[k]--;
+			continue;
+		}
+		p = pressure[k];
+		if (p == sentPressure[k])
+			continue;
+		if (!keymapPut(0x0a, KEYS_COUNT + k, p, timebaseStamp()))
+			return 1;
+		sentPressure[k] = p;
+		atWait[k] = TRAVEL_AT_INTERVAL;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* ADC conversion complete                                                   */
+/*                                                                           */
+/* The flag clears on entry. A key whose event does not fit the ring keeps   */
+/* its state and tries again at its next sample. The next conversion starts  */
+/* on the way out, so the handler cannot nest with itself.                   */
+/*---------------------------------------------------------------------------*/
+
+USB_SAFE_ISR(ADC_vect)
+{
+	uchar k = key, pos = ADCH, s;
+
+	if (k & SETTLE) {	/* still holds charge of the last channel */
+		key = k & ~SETTLE;
+		ADCSRA |= (1 << ADSC);
+		return;
+	}
+	s = state[k];
+#if TRAVEL_INVERT
+	pos = ~pos;
+#endif
+	if (s == REST) {
+		if (pos >= TRAVEL_START) {
+			armed[k] = scanRound;
+			state[k] = ARMED;
+		}
+	} else if (s == ARMED) {
+		if ((uchar) (scanRound - armed[k]) == 0xff)
+			armed[k]++;	/* slowest velocity, keep it there */
+		if (pos < TRAVEL_RELEASE) {
+			state[k] = REST;
+		} else if (pos >= TRAVEL_STRIKE) {
+			s = scanRound - armed[k];
+			if (travelPut(k << 8 | (s ? s : 1)))
+				state[k] = DOWN;
+		}
+	} else {
+		if (pos < TRAVEL_RELEASE) {
+			if (travelPut(k << 8)) {
+				pressure[k] = 0;
+				state[k] = REST;
+			}
+		} else {
+			pressure[k] = (pos > TRAVEL_AT_DEPTH) ?
+			    ((pos - TRAVEL_AT_DEPTH) * AT_SCALE) >> 8 : 0;
+		}
+	}
+	if (++k == TRAVEL_KEYS) {
+		k = 0;
+		scanRound++;
+	}
+	key = k | SETTLE;
+	select(k);
+	ADCSRA |= (1 << ADSC);
+}
+
+#else				/* TRAVEL_KEYS */
+
+void travelInit(void)
+{
+}
+
+uchar travelPoll(void)
+{
+	return 0;
+}
+
+#endif				/* TRAVEL_KEYS */
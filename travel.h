@@ -0,0 +1,59 @@
+/* Name: travel.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __travel_h_included__
+#define __travel_h_included__
+
+/*
+General Description:
+Analog keybed: every key's position (hall sensor or optical, 0 = rest,
+255 = bottom) is read by the ADC, through 4051 multiplexers for more than
+six keys (select lines S0..S2 on PD5..PD7, 8 keys per ADC input). The ADC
+complete interrupt selects the next key after each sample and throws the
+first conversion after the select away, since the sample and hold still
+carries charge from the previous key. The second one is the key's 8 bit
+sample, which runs the key's state machine:
+
+	rest ---- past TRAVEL_START ---> armed: the scan round is noted
+	armed --- past TRAVEL_STRIKE --> down: note on, time since armed
+	down ---- above TRAVEL_RELEASE --> rest: note off
+
+The time from TRAVEL_START to TRAVEL_STRIKE, in scan rounds, goes to main
+through a small ring; travelPoll() turns it into a velocity
+(TRAVEL_VELOCITY / rounds, 1..127). While a key is down past
+TRAVEL_AT_DEPTH its depth below that point becomes polyphonic aftertouch
+(CIN 0xa), sent at most every TRAVEL_AT_INTERVAL ms per key and only when
+it changed; it drops to 0 once when the key rises above the depth again.
+
+With the ADC clocked at F_CPU / 16, which is fine for 8 bits, a
+conversion takes 17 us and a key two of them, about 28000 samples per
+second: 16 keys are read at 1.8 kHz each. The interrupt takes about 60
+cycles per sample and 20 for a discarded conversion, 20% of the CPU at
+that rate, and never runs for longer than that between two V-USB
+interrupts; use TRAVEL_ADPS to trade scan rate for CPU. Shares the ADC with analog.c, only one of them
+can be enabled.
+*/
+
+#include "midicomconfig.h"
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+void travelInit(void);
+/* Configures the ADC and multiplexer pins and starts scanning.
+ */
+uchar travelPoll(void);
+/* Queues note and aftertouch events. Returns non-zero if events are left
+ * because the event queue is full. Call every millisecond.
+ */
+#if TRAVEL_KEYS
+uchar travelDown(uchar k);
+/* Non-zero from the strike of key k to its release, also while the note
+ * on is still on its way to the event queue.
+ */
+#endif
+
+#endif				/* __travel_h_included__ */
@@ -123,6 +123,50 @@ rename it to "usbconfig.h". Then edit it accordingly.
  * of the macros usbDisableAllRequests() and usbEnableAllRequests() in
  * usbdrv.h.
  */
+#ifndef __ASSEMBLER__
+extern void midiOutPanic(void);
+#endif
+#define USB_RESET_HOOK(resetStarts)     if (resetStarts) midiOutPanic();
+/* This macro is a hook if you need to know when an USB RESET occurs. It has
+ * one parameter which distinguishes between the start of RESET state and its
+ * end. midicom silences the notes the host left on DIN there (midiout.c).
+ */
+#ifndef __ASSEMBLER__
+extern void usbAddressAssigned(void);
+#endif
+#define USB_SET_ADDRESS_HOOK()          usbAddressAssigned();
+/* This macro (if defined) is executed when a USB SET_ADDRESS request was
+ * received. midicom records the time from reset to enumeration there.
+ */
+#ifndef __ASSEMBLER__
+extern void powerRxHook(unsigned char *data);
+#endif
+#define USB_RX_USER_HOOK(data, len)     powerRxHook(data);
+/* This macro (if defined) is executed for every message received, before
+ * the driver handles it. midicom follows the remote wakeup feature there
+ * (power.c).
+ */
+#define USB_COUNT_SOF                   1
+/* define this macro to 1 if you need the global variable "usbSofCount" which
+ * counts SOF packets. This feature requires that the hardware interrupt is
+ * connected to D- instead of D+.
+ * midicom's timebase (timebase.c) counts frames with it. D- is on PD3, which
+ * is INT1, so the interrupt is moved there below; no rewiring is needed.
+ */
+#ifdef __ASSEMBLER__
+.macro  timebaseSofHook
+    in      YL, TCNT0
+    sts     timebaseSofTick, YL
+.endm
+#endif
+#define USB_SOF_HOOK                    timebaseSofHook
+/* This macro (if defined) is executed in the assembler module when a
+ * Start Of Frame condition is detected. It may use the register YL and
+ * modify SREG. If it lasts longer than a couple of cycles, USB messages
+ * immediately after an SOF pulse may be lost and must be retried by the host.
+ * midicom latches Timer0 here (3 cycles) to interpolate device time between
+ * frames.
+ */
 
 /* -------------------------- Device Description --------------------------- */
 
@@ -257,12 +301,14 @@ rename it to "usbconfig.h". Then edit it accordingly.
  * which is not fully supported (such as IAR C) or if you use a differnt
  * interrupt than INT0, you may have to define some of these.
  */
-/* #define USB_INTR_CFG            MCUCR */
-/* #define USB_INTR_CFG_SET        ((1 << ISC00) | (1 << ISC01)) */
-/* #define USB_INTR_CFG_CLR        0 */
-/* #define USB_INTR_ENABLE         GIMSK */
-/* #define USB_INTR_ENABLE_BIT     INT0 */
-/* #define USB_INTR_PENDING        GIFR */
-/* #define USB_INTR_PENDING_BIT    INTF0 */
+#define USB_INTR_CFG            EICRA
+#define USB_INTR_CFG_SET        (1 << ISC11)	/* falling edge on D- */
+#define USB_INTR_CFG_CLR        0
+#define USB_INTR_ENABLE         EIMSK
+#define USB_INTR_ENABLE_BIT     INT1
+#define USB_INTR_PENDING        EIFR
+#define USB_INTR_PENDING_BIT    INTF1
+#define USB_INTR_VECTOR         INT1_vect
+/* SOF counting needs the interrupt on D- (PD3 = INT1), see USB_COUNT_SOF. */
 
 #endif				/* __usbconfig_h_included__ */
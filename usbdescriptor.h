@@ -21,6 +21,11 @@ static PROGMEM char deviceDescrMIDI[] = {	/* USB device descriptor */
 };
 
 // B.2 Configuration Descriptor
+#if POWER_REMOTE_WAKEUP
+#define CONFIG_ATTR_WAKE	USBATTR_REMOTEWAKE	/* see power.h */
+#else
+#define CONFIG_ATTR_WAKE	0
+#endif
 static PROGMEM char configDescrMIDI[] = {	/* USB configuration descriptor */
 	9,			/* sizeof(usbDescrConfig): length of descriptor in bytes */
 	USBDESCR_CONFIG,	/* descriptor type */
@@ -29,9 +34,9 @@ static PROGMEM char configDescrMIDI[] = {	/* USB configuration descriptor */
 	1,			/* index of this configuration */
 	0,			/* configuration name string index */
 #if USB_CFG_IS_SELF_POWERED
-	USBATTR_SELFPOWER,	/* attributes */
+	USBATTR_SELFPOWER | CONFIG_ATTR_WAKE,	/* attributes */
 #else
-	USBATTR_BUSPOWER,	/* attributes */
+	USBATTR_BUSPOWER | CONFIG_ATTR_WAKE,	/* attributes */
 #endif
 	USB_CFG_MAX_BUS_POWER / 2,	/* max USB current in 2mA units */
 
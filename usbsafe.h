@@ -0,0 +1,97 @@
+/* Name: usbsafe.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __usbsafe_h_included__
+#define __usbsafe_h_included__
+
+/*
+General Description:
+Interrupt handlers that coexist with V-USB. The USB interrupt must not be
+held off for more than 25 cycles at 12 MHz (see usbdrv.h, "Interrupt
+latency"), and a plain ISR() pushes every register it uses before its
+first statement, which alone can take longer than that. Rules for every
+interrupt other than the USB one:
+
+1. Sources whose flag clears when the vector is taken (timer compare and
+   overflow, pin change, ADC complete) use USB_SAFE_ISR(). It is
+   ISR_NOBLOCK: "sei" is the first instruction.
+
+2. Level sources that stay pending until the handler acts (USART receive
+   and data register empty, SPI, TWI) use USB_SAFE_ISR_MASKED(). A naked
+   stub masks the source's enable bit, re-enables interrupts 11 cycles
+   after the vector and calls the body as an ordinary function. The body
+   returns non-zero to unmask the source again on the way out; returning
+   0 leaves it masked until main re-arms it (USART UDRE when idle).
+
+3. Bodies run with interrupts enabled and may be interrupted by USB for up
+   to 100 us per message. Keep them short anyway (a few hundred cycles)
+   so main and the other handlers are not starved between USB messages,
+   and make them re-entrant-safe against main: single-writer indices, no
+   shared multi-byte values without a lock.
+
+4. Main and the bodies use cli only around a read-modify-write or a
+   multi-byte access of a few cycles, restoring SREG rather than calling
+   sei(), so the same helper works before interrupts are enabled.
+
+The one exception is WDT_vect in crashlog.c, which never returns.
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#ifndef uchar
+#   define  uchar   unsigned char
+#endif
+
+#define USB_SAFE_ISR(vect)	ISR(vect, ISR_NOBLOCK)
+
+/* Declares the body of a masked handler: uchar body(void). */
+#define USB_SAFE_BODY(body) \
+	static uchar body(void) __attribute__ ((used, noinline)); \
+	static uchar body(void)
+
+/* The stub saves r24 and SREG before touching the enable bit, then the
+ * registers a called function may clobber. On the way out the scratch
+ * registers are popped with interrupts on; only the unmask, the SREG
+ * restore and reti run under cli, 15 cycles. reg is a memory mapped
+ * enable register such as UCSR0B.
+ */
+#define USB_SAFE_ISR_MASKED(vect, reg, bit, body) \
+ISR(vect, ISR_NAKED) \
+{ \
+	asm volatile ( \
+		"push r24\n\t" \
+		"in r24, __SREG__\n\t" \
+		"push r24\n\t" \
+		"lds r24, %[en]\n\t" \
+		"andi r24, %[off]\n\t" \
+		"sts %[en], r24\n\t" \
+		"sei\n\t" \
+		"push r0\n\t" "push r1\n\t" "clr r1\n\t" \
+		"push r18\n\t" "push r19\n\t" "push r20\n\t" "push r21\n\t" \
+		"push r22\n\t" "push r23\n\t" "push r25\n\t" "push r26\n\t" \
+		"push r27\n\t" "push r30\n\t" "push r31\n\t" \
+		"call " #body "\n\t" \
+		"pop r31\n\t" "pop r30\n\t" "pop r27\n\t" "pop r26\n\t" \
+		"pop r25\n\t" "pop r23\n\t" "pop r22\n\t" "pop r21\n\t" \
+		"pop r20\n\t" "pop r19\n\t" "pop r18\n\t" \
+		"pop r1\n\t" "pop r0\n\t" \
+		"tst r24\n\t" \
+		"breq 1f\n\t" \
+		"cli\n\t" \
+		"lds r24, %[en]\n\t" \
+		"ori r24, %[on]\n\t" \
+		"sts %[en], r24\n\t" \
+		"1:\n\t" \
+		"pop r24\n\t" \
+		"out __SREG__, r24\n\t" \
+		"pop r24\n\t" \
+		"reti\n\t" \
+		:: [en] "n" (_SFR_MEM_ADDR(reg)), \
+		   [off] "M" ((uchar) ~(1 << (bit))), \
+		   [on] "M" (1 << (bit))); \
+}
+
+#endif				/* __usbsafe_h_included__ */
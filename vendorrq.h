@@ -0,0 +1,95 @@
+/* Name: vendorrq.h
+ * Project: midicom
+ * License: GNU General Public License version 2.
+ */
+
+#ifndef __vendorrq_h_included__
+#define __vendorrq_h_included__
+
+/*
+General Description:
+Vendor specific control requests on endpoint 0, shared with host software.
+All multi-byte values are little endian. Requests the firmware was built
+without are answered with zero length data.
+*/
+
+#define RQ_GET_IN_STATS		1
+/* Device to host, returns midiInStats_t (see midiin.h): realtime latency
+ * from the DIN stop bit to the interrupt-in hand-off.
+ */
+#define RQ_RESET_IN_STATS	2
+/* No data, clears the counters returned by RQ_GET_IN_STATS.
+ */
+#define RQ_SET_TIMESTAMPS	3
+/* No data, wValue = 1 turns the event timestamp side channel on, 0 off.
+ */
+#define RQ_GET_TIMESTAMPS	4
+/* Device to host, drains the capture times of events already sent on the
+ * interrupt-in endpoint (see midiin.h). Byte 0 is the sequence number (mod
+ * 256) of the event the first stamp belongs to, byte 1 the number of stamps
+ * that follow, at most (wLength - 2) / 2. Then comes one 16 bit stamp per
+ * event in 1/256 ms of device time, little endian. Stamps the host did not
+ * collect in time are dropped oldest first; the sequence number tells how
+ * many.
+ */
+#define RQ_GET_TIME		5
+/* Device to host, 6 bytes: current device time (4 bytes, 1/256 ms, see
+ * timebase.h), 1 if the time is locked to host frames, free schedule slots.
+ */
+#define RQ_SCHEDULE_OUT		6
+/* Host to device, a multiple of 8 bytes up to 248: per event the due
+ * device time (4 bytes) and a USB-MIDI event packet (4 bytes), see
+ * midiout.h. Stalls without queueing anything if the length is wrong or
+ * the events do not all fit in the free schedule slots (RQ_GET_TIME), so
+ * the host can retry the whole request. Events already due are sent
+ * immediately.
+ */
+#define RQ_GET_BOOT_INFO	7
+/* Device to host, 5 bytes: MCUSR reset flags of the last start and the
+ * device time (4 bytes, 1/256 ms) at which the host assigned our address,
+ * i.e. the time from reset to enumeration.
+ */
+#define RQ_GET_CRASH_LOG	8
+/* Device to host, 12 bytes: crashLog_t, see crashlog.h. Tells where the
+ * main loop hung before the last watchdog reset and how often that happened
+ * since power-on.
+ */
+#define RQ_CLEAR_CRASH_LOG	9
+/* Clears the crash record and the watchdog reset counter.
+ */
+#define RQ_GET_TASK_STATS	10
+/* Device to host, 2 bytes per main loop task in table order: budget
+ * overruns and the longest run in 1/256 ms, see tasks.h.
+ */
+#define RQ_RESET_TASK_STATS	11
+/* Clears the task statistics.
+ */
+#define RQ_GET_RAM_INFO		12
+/* Device to host, 6 bytes: stack bytes never used since reset, linked data
+ * size and the planned data size from midicomconfig.h, see ramplan.h.
+ */
+#define RQ_GET_POWER_STATS	13
+/* Device to host, 11 bytes: powerStats_t, see power.h. Device time spent
+ * in idle sleep and in total (4 bytes each, 1/256 ms), bus suspends,
+ * power-down sleeps and remote wakeups signalled.
+ */
+#define RQ_RESET_POWER_STATS	14
+/* Clears the counters returned by RQ_GET_POWER_STATS.
+ */
+#define RQ_READ_CONFIG		15
+/* Device to host, wLength bytes of config_t (see config.h) from byte wIndex
+ * on, in as many packets as needed; shorter if that passes the end.
+ */
+#define RQ_WRITE_CONFIG		16
+/* Host to device, wLength bytes into config_t from byte wIndex on. Applied
+ * after the last packet and saved to EEPROM in the background. Bytes past
+ * the end of config_t are dropped. Stalls at the first packet, with
+ * nothing written, if the event queue has no room for the note offs of
+ * the keys held down (see keymap.h); try again.
+ */
+#define RQ_RESET_CONFIG		17
+/* No data, restores and saves the firmware defaults. Does nothing in the
+ * case RQ_WRITE_CONFIG stalls.
+ */
+
+#endif				/* __vendorrq_h_included__ */